@@ -0,0 +1,216 @@
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "theme.h"
+#include "atlas.h"
+#include "pack.h"
+#include "assets.h"
+
+
+
+/* Implementation of AssetLoader */
+
+
+AssetLoader::AssetLoader()
+    : _done{0}, _total{0}, stopping{false} {
+
+    worker = std::thread(&AssetLoader::work, this);
+}
+
+
+AssetLoader::~AssetLoader() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    for (Job &job : decoded)
+        if (job.surface) SDL_FreeSurface(job.surface);
+}
+
+
+void AssetLoader::load_tile_map(const std::string &file, Pair<uint8_t> tile_size,
+                                const TextureMapping *mapping, OnTileMap on_loaded) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queued.push_back(Job{ file, tile_size, mapping, on_loaded, nullptr,
+                              "", nullptr, nullptr, nullptr, TileLegend() });
+        _total++;
+    }
+    wake.notify_one();
+}
+
+
+void AssetLoader::load_pack(const std::string &pack_file, const Theme &theme,
+                            OnTileMap on_loaded, OnPalette on_palette) {
+
+    std::shared_ptr<const Theme> shared(new Theme(theme));
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queued.push_back(Job{ theme.tilesets.front().texture, theme.tilesets.front().tile_size, nullptr,
+                              on_loaded, nullptr, pack_file, shared, on_palette, nullptr, TileLegend() });
+        _total++;
+    }
+    wake.notify_one();
+}
+
+
+void AssetLoader::work() {
+
+    for (;;) {
+
+        Job job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || !queued.empty(); });
+            if (stopping) return;
+
+            job = queued.front();
+            queued.pop_front();
+        }
+
+        if (!job.pack_file.empty()) open_pack(job);
+        if (!job.pack) decode(job);
+
+        std::lock_guard<std::mutex> guard(lock);
+        decoded.push_back(job);
+    }
+}
+
+
+void AssetLoader::decode(Job &job) {
+
+    if (job.theme) {
+        job.surface = load_atlas(*job.theme, job.legend);
+        return;
+    }
+
+    SDL_Surface *surface = SDL_LoadBMP(job.file.c_str());
+
+    if (surface == nullptr) {
+        fprintf(stderr, "SDL_LoadBMP Error: %s\n", SDL_GetError());
+        return;
+    }
+
+    // converting here leaves nothing for the upload to do but copy
+    job.surface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (job.surface == nullptr) {
+        fprintf(stderr, "SDL_ConvertSurfaceFormat Error: %s\n", SDL_GetError());
+    }
+    SDL_FreeSurface(surface);
+}
+
+
+void AssetLoader::open_pack(Job &job) {
+
+    const Theme &theme = *job.theme;
+
+    // hashing reads the BMP file, but never decodes it
+    const uint64_t hash = pack_source_hash(theme);
+
+    std::shared_ptr<AssetPack> pack(new AssetPack());
+
+    // without the BMP files to compare against, the pack is all there is
+    bool fresh = pack->open(job.pack_file) && (hash == 0 || pack->content_hash() == hash);
+
+    if (!fresh) {
+        pack->close();
+        fresh = bake_pack(theme, job.pack_file)
+             && pack->open(job.pack_file);
+    }
+
+    if (!fresh) return;
+
+    job.surface = pack->surface();
+    if (job.surface) job.pack = pack;
+}
+
+
+bool AssetLoader::poll() {
+
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.swap(decoded);
+    }
+
+    bool ok = true;
+
+    for (Job &job : ready) {
+        _done++;
+
+        if (job.surface == nullptr) {
+            fprintf(stderr, "AssetLoader Error: could not load %s\n", job.file.c_str());
+            ok = false;
+            continue;
+        }
+
+        TileMap *map = nullptr;
+        try {
+            if      (job.pack)  map = new TileMap(job.surface, job.pack->legend());
+            else if (job.theme) map = new TileMap(job.surface, job.legend);
+            else                map = new TileMap(job.surface, job.tile_size, job.mapping);
+        } catch (const char *) {
+            ok = false;
+        }
+
+        // the surface may point into the pack, which is closed along with `ready`
+        SDL_FreeSurface(job.surface);
+        if (map) job.on_loaded(map);
+
+        if (job.on_palette) job.on_palette(job.pack ? job.pack->palette() : job.theme->palette());
+    }
+
+    return ok;
+}
+
+
+uint16_t AssetLoader::done()  const { return _done;  }
+uint16_t AssetLoader::total() const { return _total; }
+
+bool AssetLoader::finished() const { return _done == _total; }
+
+
+
+bool draw_progress(const AssetLoader &loader) {
+
+    const ColorRGBA fg = render_config.palette().at(PaletteColor::FG_1);
+
+    // the bar, a third of the screen wide
+    SDL_Rect outline{ SCREEN_WIDTH / 3, SCREEN_HEIGHT / 2 - 4, SCREEN_WIDTH / 3, 8 };
+    SDL_Rect filled = outline;
+    filled.w = loader.total() ? outline.w * loader.done() / loader.total() : 0;
+
+    // the bar needs the SDL renderer, which other backends go without
+    if (renderer != nullptr) {
+        SDL_SetRenderDrawColor(renderer, fg.r, fg.g, fg.b, fg.a);
+        bool ok = SDL_RenderDrawRect(renderer, &outline) == 0
+               && SDL_RenderFillRect(renderer, &filled)  == 0;
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+
+        if (!ok) {
+            fprintf(stderr, "SDL_RenderFillRect Error: %s", SDL_GetError());
+            return false;
+        }
+    }
+
+    // text needs glyphs, which only arrive with the first tile map
+    if (!render_config.has_tile_map()) return true;
+
+    const std::string text = "loading " + std::to_string(loader.done()) + "/" + std::to_string(loader.total());
+
+    return draw_string(
+        text,
+        std::make_pair(SCREEN_TILES_WIDE / 2 - text.size() / 2, SCREEN_TILES_HIGH / 2 + 1),
+        style_from_palette(PaletteColor::FG_1)
+    );
+}
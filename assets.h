@@ -0,0 +1,108 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+#include "render.h"
+#include "pack.h"
+#include "theme.h"
+
+
+/*
+    Loads assets without stalling the game: image files are
+    decoded on a worker thread, and only uploading them to the
+    GPU (which SDL requires of the render thread) happens in
+    `poll`, once per frame. Each asset is handed over to its
+    callback as soon as it is ready.
+*/
+class AssetLoader {
+public:
+
+    // Called on the render thread with a new tile map, which it then owns
+    typedef std::function<void(TileMap *)> OnTileMap;
+
+    // Called on the render thread with a new palette, which it then owns
+    typedef std::function<void(Palette *)> OnPalette;
+
+    AssetLoader();
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    /* Queue up a tile map to be loaded from a BMP file */
+    void load_tile_map(const std::string &file, Pair<uint8_t> tile_size,
+                       const TextureMapping *, OnTileMap);
+
+    /*
+        Queue up the tile map and palette of `theme` to be loaded
+        from the pack at `pack_file`. If the pack is missing, or was
+        baked from a different texture, legend or palette than the
+        theme's, it is baked again first. Should the pack not be
+        writable, the texture is loaded directly instead.
+    */
+    void load_pack(const std::string &pack_file, const Theme &theme, OnTileMap, OnPalette);
+
+    /*
+        Upload everything decoded since the last call, and hand
+        it over. Must be called from the render thread. Returns
+        false if anything failed to load.
+    */
+    bool poll();
+
+    /* The number of assets handed over, and the number queued in total */
+    uint16_t done()  const;
+    uint16_t total() const;
+
+    bool finished() const;
+
+private:
+
+    struct Job {
+        std::string           file;
+        Pair<uint8_t>         tile_size;
+        const TextureMapping *mapping;
+        OnTileMap             on_loaded;
+        SDL_Surface          *surface;
+
+        // only used when loading from a pack
+        std::string                  pack_file;
+        std::shared_ptr<const Theme> theme;
+        OnPalette                    on_palette;
+        std::shared_ptr<AssetPack>   pack;
+        TileLegend                   legend; // of the atlas, when loaded without a pack
+    };
+
+    void work();
+    void decode(Job &);
+    void open_pack(Job &);
+
+    std::mutex              lock;
+    std::condition_variable wake;
+
+    std::deque<Job> queued;    // waiting to be decoded
+    std::vector<Job> decoded;  // waiting to be uploaded
+
+    uint16_t _done, _total;
+    bool     stopping;
+
+    std::thread worker;
+
+};
+
+
+/*
+    Draw a loading screen: a bar filling up with the progress
+    of `loader`, and once there is a tile map to draw text with,
+    a count of the assets loaded so far.
+*/
+bool draw_progress(const AssetLoader &);
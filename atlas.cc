@@ -0,0 +1,258 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "types.h"
+#include "render.h"
+#include "theme.h"
+#include "atlas.h"
+
+
+static constexpr size_t TILE_COUNT = static_cast<size_t>(Tile::IDS_COUNT);
+
+// Space left between regions, so filtering never bleeds one into the next
+static constexpr uint16_t ATLAS_PADDING = 1u;
+
+
+
+/* Implementation of SkylinePacker */
+
+
+SkylinePacker::SkylinePacker(uint16_t width, uint16_t height)
+    : skyline{ Segment{ 0, 0, width } }, width{width}, height{height} { }
+
+
+bool SkylinePacker::insert(uint16_t w, uint16_t h, Pair<uint16_t> &at) {
+
+    size_t   best   = skyline.size();
+    uint32_t best_y = UINT32_MAX;
+
+    for (size_t i = 0; i < skyline.size(); i++) {
+
+        // segments are in order, so nothing further along fits either
+        if ((uint32_t)skyline[i].x + w > width) break;
+
+        // the rectangle rests on the highest segment beneath it
+        uint32_t y = 0;
+        int32_t  left = w;
+        for (size_t j = i; left > 0; j++) {
+            y = std::max<uint32_t>(y, skyline[j].y);
+            left -= skyline[j].w;
+        }
+
+        if (y + h > height || y >= best_y) continue;
+
+        best   = i;
+        best_y = y;
+    }
+
+    if (best == skyline.size()) return false;
+
+    at = std::make_pair(skyline[best].x, (uint16_t)best_y);
+
+
+    /* Raise the skyline over the new rectangle */
+
+    skyline.insert(skyline.begin() + best, Segment{ at.first, (uint16_t)(best_y + h), w });
+
+    for (size_t i = best + 1; i < skyline.size();) {
+        const uint16_t covered = skyline[i - 1].x + skyline[i - 1].w;
+        if (skyline[i].x >= covered) break;
+
+        const uint16_t overlap = covered - skyline[i].x;
+        if (skyline[i].w <= overlap) {
+            skyline.erase(skyline.begin() + i);
+        } else {
+            skyline[i].x += overlap;
+            skyline[i].w -= overlap;
+            break;
+        }
+    }
+
+    // neighbors of the same height are really one segment
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].w += skyline[i + 1].w;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+
+    return true;
+}
+
+
+uint16_t SkylinePacker::used_height() const {
+    uint16_t h = 0;
+    for (const Segment &s : skyline) h = std::max(h, s.y);
+    return h;
+}
+
+
+
+/* Packing tilesets */
+
+
+SDL_Surface *pack_atlas(const std::vector<SDL_Surface *> &surfaces, const TileSources &source,
+                        TileLegend &legend, uint16_t max_size) {
+
+    struct Region {
+        uint8_t        source;
+        SDL_Rect       from;
+        Pair<uint16_t> to;
+    };
+
+    std::vector<Region> regions;
+    std::array<int16_t, TILE_COUNT> region_of;
+    region_of.fill(-1);
+
+    uint32_t area = 0;
+    uint16_t widest = 0;
+
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+
+        const SDL_Rect &r = legend[t];
+        if (r.w <= 0 || r.h <= 0) continue;
+
+        const SDL_Surface *s = source[t] < surfaces.size() ? surfaces[source[t]] : nullptr;
+        if (s == nullptr || r.x < 0 || r.y < 0 || r.x + r.w > s->w || r.y + r.h > s->h) {
+            fprintf(stderr, "Atlas Error: tile %s lies outside of its texture\n", tile_name(Tile(t)));
+            return nullptr;
+        }
+
+        // the same region, wanted by several tiles, is only copied once
+        for (size_t i = 0; i < regions.size(); i++) {
+            const Region &other = regions[i];
+            if (other.source == source[t] && other.from.x == r.x && other.from.y == r.y
+             && other.from.w == r.w && other.from.h == r.h) {
+                region_of[t] = (int16_t)i;
+                break;
+            }
+        }
+        if (region_of[t] >= 0) continue;
+
+        region_of[t] = (int16_t)regions.size();
+        regions.push_back(Region{ source[t], r, std::make_pair(0, 0) });
+
+        area  += (uint32_t)(r.w + ATLAS_PADDING) * (r.h + ATLAS_PADDING);
+        widest = std::max<uint16_t>(widest, r.w + ATLAS_PADDING);
+    }
+
+
+    /* Tallest first, trying wider atlases until everything fits */
+
+    std::vector<size_t> order(regions.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&regions](size_t a, size_t b) {
+        if (regions[a].from.h != regions[b].from.h) return regions[a].from.h > regions[b].from.h;
+        return regions[a].from.w > regions[b].from.w;
+    });
+
+    uint32_t width = 64;
+    while (width * width < area || width < widest) width *= 2;
+
+    uint16_t height = 0;
+
+    for (;; width *= 2) {
+        if (width > max_size) {
+            fprintf(stderr, "Atlas Error: tiles do not fit in a %u pixel square atlas\n", max_size);
+            return nullptr;
+        }
+
+        SkylinePacker packer((uint16_t)width, max_size);
+
+        bool fits = true;
+        for (size_t i : order) {
+            const SDL_Rect &r = regions[i].from;
+            if (!packer.insert(r.w + ATLAS_PADDING, r.h + ATLAS_PADDING, regions[i].to)) {
+                fits = false;
+                break;
+            }
+        }
+
+        if (fits) {
+            height = std::max<uint16_t>(packer.used_height(), 1);
+            break;
+        }
+    }
+
+
+    /* Copy each region across, row by row, since the formats already match */
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (atlas == nullptr) {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormat Error: %s\n", SDL_GetError());
+        return nullptr;
+    }
+
+    SDL_LockSurface(atlas);
+    memset(atlas->pixels, 0, (size_t)atlas->pitch * atlas->h);
+
+    for (SDL_Surface *s : surfaces) SDL_LockSurface(s);
+
+    for (const Region &region : regions) {
+        const SDL_Surface *s = surfaces[region.source];
+
+        for (int y = 0; y < region.from.h; y++) {
+            const uint8_t *src = (const uint8_t *)s->pixels + (size_t)(region.from.y + y) * s->pitch + region.from.x * 4;
+            uint8_t       *dst = (uint8_t *)atlas->pixels + (size_t)(region.to.second + y) * atlas->pitch + region.to.first * 4;
+            memcpy(dst, src, (size_t)region.from.w * 4);
+        }
+    }
+
+    for (SDL_Surface *s : surfaces) SDL_UnlockSurface(s);
+    SDL_UnlockSurface(atlas);
+
+
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+        if (region_of[t] < 0) continue;
+        const Region &region = regions[region_of[t]];
+        legend[t] = SDL_Rect{ region.to.first, region.to.second, region.from.w, region.from.h };
+    }
+
+    return atlas;
+}
+
+
+
+SDL_Surface *load_atlas(const Theme &theme, TileLegend &legend) {
+
+    std::vector<SDL_Surface *> surfaces;
+
+    for (const Theme::Tileset &set : theme.tilesets) {
+
+        SDL_Surface *loaded = SDL_LoadBMP(set.texture.c_str());
+        SDL_Surface *surface = nullptr;
+
+        if (loaded == nullptr) {
+            fprintf(stderr, "SDL_LoadBMP Error: %s\n", SDL_GetError());
+        } else {
+            surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+            if (surface == nullptr) {
+                fprintf(stderr, "SDL_ConvertSurfaceFormat Error: %s\n", SDL_GetError());
+            }
+            SDL_FreeSurface(loaded);
+        }
+
+        if (surface == nullptr) {
+            for (SDL_Surface *s : surfaces) SDL_FreeSurface(s);
+            return nullptr;
+        }
+
+        surfaces.push_back(surface);
+    }
+
+    legend = theme.legend;
+
+    // a single tileset is already an atlas
+    if (surfaces.size() == 1) return surfaces[0];
+
+    SDL_Surface *atlas = pack_atlas(surfaces, theme.source, legend);
+
+    for (SDL_Surface *s : surfaces) SDL_FreeSurface(s);
+    return atlas;
+}
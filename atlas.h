@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+#include "types.h"
+#include "render.h"
+#include "theme.h"
+
+
+/*
+    Packs rectangles into a fixed size area, keeping track
+    of the "skyline" left by the rectangles placed so far:
+    the height of the topmost rectangle across each stretch
+    of the area. Each rectangle is placed wherever it would
+    sit lowest, which works well for rectangles inserted from
+    the tallest down, as tiles of a few sizes tend to be.
+*/
+class SkylinePacker {
+public:
+
+    SkylinePacker(uint16_t width, uint16_t height);
+
+    /* Find room for a `w` by `h` rectangle, returning false if there is none */
+    bool insert(uint16_t w, uint16_t h, Pair<uint16_t> &at);
+
+    /* The height reached by the rectangles placed so far */
+    uint16_t used_height() const;
+
+private:
+
+    struct Segment {
+        uint16_t x, y, w;
+    };
+
+    std::vector<Segment> skyline;
+
+    uint16_t width, height;
+
+};
+
+
+/*
+    Copy the regions of `legend` out of several surfaces into one
+    new atlas, with `source` giving the surface each tile is found
+    in, and rewrite `legend` to match. Tiles which share a region
+    share it in the atlas too. Every surface must be ARGB8888.
+
+    The atlas is kept as small as will fit, up to `max_size`
+    pixels square; returns nullptr if the regions do not fit.
+*/
+SDL_Surface *pack_atlas(const std::vector<SDL_Surface *> &surfaces, const TileSources &source,
+                        TileLegend &legend, uint16_t max_size = 4096);
+
+
+/*
+    Load the textures of every tileset in `theme` and pack them
+    into a single ARGB8888 atlas, setting `legend` to where each
+    tile ended up. A theme with only one tileset needs no packing,
+    so its texture is returned as it is.
+*/
+SDL_Surface *load_atlas(const Theme &theme, TileLegend &legend);
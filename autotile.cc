@@ -0,0 +1,187 @@
+
+#include "types.h"
+#include "grid.h"
+#include "world.h"
+#include "autotile.h"
+
+
+
+static constexpr uint8_t FIRST_BORDER = static_cast<uint8_t>(Tile::BORDER_N);
+static constexpr uint8_t LAST_BORDER  = static_cast<uint8_t>(Tile::BORDER_ROUND_NONE_BOLD);
+
+// The number of tiles in each border family
+static constexpr uint8_t FAMILY_SIZE = 16u;
+
+
+/*
+    Offset within a family (in the order the families are
+    declared in types.h) for each neighbor mask.
+*/
+static const uint8_t MASK_TO_OFFSET[16] = {
+    15, // none      -> NONE
+     0, // N         -> N
+     1, // S         -> S
+     8, // N S       -> NS
+     3, // W         -> W
+     4, // N W       -> NW
+     6, // S W       -> SW
+    10, // N S W     -> NSW
+     2, // E         -> E
+     5, // N E       -> NE
+     7, // S E       -> SE
+    11, // N S E     -> NSE
+     9, // W E       -> WE
+    13, // N W E     -> NWE
+    12, // S W E     -> SWE
+    14, // N S W E   -> NSWE
+};
+
+
+
+bool Autotile::is_border(Tile t) {
+    uint8_t id = static_cast<uint8_t>(t);
+    return id >= FIRST_BORDER && id <= LAST_BORDER;
+}
+
+
+Tile Autotile::border_for(Tile t, uint8_t mask) {
+    uint8_t family = (static_cast<uint8_t>(t) - FIRST_BORDER) / FAMILY_SIZE;
+    return Tile(FIRST_BORDER + family * FAMILY_SIZE + MASK_TO_OFFSET[mask & 0xF]);
+}
+
+
+
+/*
+    Single cell updates
+*/
+
+
+template <class Map>
+static bool wall_at(Map &map, int32_t x, int32_t y) {
+    return map.in_bounds(x, y) && Autotile::is_border(map.at(x, y));
+}
+
+static void set_tile(TileGrid &grid, int32_t x, int32_t y, Tile t) { grid.at(x, y) = t; }
+static void set_tile(World &world, int32_t x, int32_t y, Tile t)   { world.set(x, y, t); }
+
+template <class Map>
+static void retile(Map &map, int32_t x, int32_t y) {
+
+    if (!wall_at(map, x, y)) return;
+
+    uint8_t mask = (wall_at(map, x, y - 1) ? Autotile::N : 0)
+                 | (wall_at(map, x, y + 1) ? Autotile::S : 0)
+                 | (wall_at(map, x - 1, y) ? Autotile::W : 0)
+                 | (wall_at(map, x + 1, y) ? Autotile::E : 0);
+
+    Tile t = Autotile::border_for(map.at(x, y), mask);
+
+    if (map.at(x, y) != t) {
+        // only write when something changed, so that
+        // World chunks stay untouched where possible
+        set_tile(map, x, y, t);
+    }
+}
+
+template <class Map>
+static void update_around(Map &map, int32_t x, int32_t y) {
+    retile(map, x,     y);
+    retile(map, x,     y - 1);
+    retile(map, x,     y + 1);
+    retile(map, x - 1, y);
+    retile(map, x + 1, y);
+}
+
+void Autotile::update(TileGrid &grid, int x, int y) { update_around(grid, x, y); }
+
+void Autotile::update(World &world, int32_t x, int32_t y) { update_around(world, x, y); }
+
+
+
+/*
+    Bulk updates.
+
+    Each row of (up to 62) cells is turned into a 64 bit word
+    of wall flags, with one extra bit of context on either side.
+    The neighbor masks for a whole row then come from just a few
+    shifts and ands against the rows above and below, leaving
+    only a table lookup per wall cell.
+*/
+
+
+// The number of cells handled per row word
+static constexpr uint8_t STRIP_WIDTH = 62u;
+
+
+/* Wall bits for `width` cells starting at `x`, plus a bit on either side */
+template <class Map>
+static uint64_t row_bits(Map &map, int32_t x, int32_t y, uint8_t width) {
+    uint64_t bits = 0;
+    for (int32_t i = -1; i <= (int32_t)width; i++) {
+        if (wall_at(map, x + i, y)) bits |= (uint64_t)1 << (i + 1);
+    }
+    return bits;
+}
+
+
+/* Re-tile one row of cells, given the wall bits for it and its neighbors */
+static void resolve_row(uint64_t above, uint64_t here, uint64_t below, uint8_t width, Tile *out) {
+
+    const uint64_t n = here & above;
+    const uint64_t s = here & below;
+    const uint64_t w = here & (here << 1);
+    const uint64_t e = here & (here >> 1);
+
+    // ignore the context bits themselves
+    uint64_t cells = here & ((((uint64_t)1 << width) - 1) << 1);
+
+    while (cells) {
+        uint8_t i = __builtin_ctzll(cells);
+        cells &= cells - 1;
+
+        uint8_t mask = (uint8_t)(((n >> i) & 1)
+                               | ((s >> i) & 1) << 1
+                               | ((w >> i) & 1) << 2
+                               | ((e >> i) & 1) << 3);
+
+        out[i - 1] = Autotile::border_for(out[i - 1], mask);
+    }
+}
+
+
+void Autotile::bulk(TileGrid &grid) {
+
+    for (int32_t x = 0; x < grid.width(); x += STRIP_WIDTH) {
+
+        uint8_t width = grid.width() - x < STRIP_WIDTH ? grid.width() - x : STRIP_WIDTH;
+
+        uint64_t above = 0;
+        uint64_t here  = row_bits(grid, x, 0, width);
+
+        for (int32_t y = 0; y < grid.height(); y++) {
+            uint64_t below = row_bits(grid, x, y + 1, width);
+            if (here) resolve_row(above, here, below, width, grid.row(y) + x);
+            above = here;
+            here  = below;
+        }
+    }
+}
+
+
+void Autotile::bulk(World &world, uint16_t cx, uint16_t cy) {
+
+    const int32_t x = cx * CHUNK_SIZE;
+    const int32_t y0 = cy * CHUNK_SIZE;
+
+    Chunk &c = world.chunk(cx, cy);
+
+    uint64_t above = row_bits(world, x, y0 - 1, CHUNK_SIZE);
+    uint64_t here  = row_bits(world, x, y0,     CHUNK_SIZE);
+
+    for (uint16_t j = 0; j < CHUNK_SIZE; j++) {
+        uint64_t below = row_bits(world, x, y0 + j + 1, CHUNK_SIZE);
+        if (here) resolve_row(above, here, below, CHUNK_SIZE, &c.at(0, j));
+        above = here;
+        here  = below;
+    }
+}
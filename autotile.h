@@ -0,0 +1,44 @@
+
+#pragma once
+
+#include "types.h"
+#include "grid.h"
+#include "world.h"
+
+
+/*
+    Choosing the correct `BORDER_*` tile for each wall
+    based on which of its four neighbors are also walls.
+
+    Any tile from one of the four border families
+    (plain, bold, round, round bold) counts as a wall, and
+    keeps its family when it is re-tiled, so generators can
+    emit `BORDER_NONE` (or `BORDER_NONE_BOLD`, ...) everywhere
+    and let the autotiler connect them up.
+*/
+namespace Autotile {
+
+    // Bits of a neighbor mask
+    static constexpr uint8_t N = 1u << 0;
+    static constexpr uint8_t S = 1u << 1;
+    static constexpr uint8_t W = 1u << 2;
+    static constexpr uint8_t E = 1u << 3;
+
+    /* Whether the tile belongs to one of the border families */
+    bool is_border(Tile);
+
+    /* The tile in the same family as `t` connecting to the neighbors in `mask` */
+    Tile border_for(Tile t, uint8_t mask);
+
+
+    /* Re-tile a single edited cell and its four neighbors */
+    void update(TileGrid &, int x, int y);
+    void update(World &, int32_t x, int32_t y);
+
+    /* Re-tile everything at once */
+    void bulk(TileGrid &);
+
+    /* Re-tile a whole chunk (using its neighbors' edges for the borders) */
+    void bulk(World &, uint16_t cx, uint16_t cy);
+
+}
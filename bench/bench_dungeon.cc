@@ -0,0 +1,84 @@
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+#include "dungeon.h"
+
+
+/*
+    Benchmark for floor generation.
+
+    For each map size, reports single-threaded floors/sec with
+    median and p99 generation time, and then the throughput of
+    the background prefetcher pulling floors one after another.
+*/
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+
+int main() {
+
+    static const Pair<uint16_t> sizes[] = {
+        {  48,  28 },
+        { 128, 128 },
+        { 256, 256 },
+        { 512, 512 },
+    };
+
+    printf("%-10s %10s %10s %10s %14s\n", "size", "floors/s", "p50 (us)", "p99 (us)", "prefetch/s");
+
+    for (const Pair<uint16_t> &size : sizes) {
+
+        // fewer runs for the big maps, to keep the whole run short
+        const size_t runs = std::max<size_t>(50, 4000000 / (size.first * size.second));
+
+        std::vector<double> times;
+        times.reserve(runs);
+
+        TileGrid floor(size.first, size.second);
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < runs; i++) {
+            Clock::time_point t = Clock::now();
+            Dungeon::generate_floor(floor, 1234, i);
+            times.push_back(elapsed_us(t));
+        }
+        const double total = elapsed_us(start);
+
+        std::sort(times.begin(), times.end());
+
+
+        // Taking floors in order from the prefetcher, as a player would
+        // (there is no game work between floors, so this is a worst case)
+        FloorPrefetcher prefetcher(1234, size.first, size.second, 4, 4);
+
+        start = Clock::now();
+        for (size_t i = 0; i < runs; i++) {
+            TileGrid taken = prefetcher.take(i);
+        }
+        const double prefetch_total = elapsed_us(start);
+
+
+        char name[16];
+        snprintf(name, sizeof(name), "%ux%u", size.first, size.second);
+
+        printf("%-10s %10.0f %10.1f %10.1f %14.0f\n",
+            name,
+            runs / (total / 1e6),
+            times[times.size() / 2],
+            times[times.size() * 99 / 100],
+            runs / (prefetch_total / 1e6)
+        );
+    }
+
+    return 0;
+}
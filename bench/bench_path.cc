@@ -0,0 +1,176 @@
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+#include "dungeon.h"
+#include "path.h"
+
+
+/*
+    Benchmark for pathfinding on a world sized floor.
+
+    A chase map towards the player is computed from scratch and
+    updated as doors open and shut, then 2,000 actors each step
+    downhill on it every tick. Several independent maps are also
+    computed in parallel, and A* queries are timed on their own.
+*/
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+
+static constexpr uint16_t MAP_SIZE = 512u;
+static constexpr size_t   ACTORS   = 2000u;
+static constexpr size_t   TICKS    = 200u;
+
+
+/*
+    A goal below zero next to a wall, which must stay blocked, and
+    leave everything behind it unreachable, however the map was
+    worked out. Wide enough for the rows to be relaxed with SSE2.
+*/
+static bool check_negative_goal() {
+
+    const uint16_t w = 40, h = 8, wall = 10;
+
+    CostGrid cost(w, h);
+    for (uint16_t y = 0; y < h; y++)
+    for (uint16_t x = 0; x < w; x++)
+        cost.at(x, y) = x == wall ? PATH_BLOCKED : 1;
+
+    DijkstraMap map(w, h);
+    map.add_goal(2, 1, -10);
+
+    auto check = [&](const char *how) {
+        for (uint16_t y = 0; y < h; y++)
+        for (uint16_t x = wall; x < w; x++) {
+            if (map.at(x, y) != PATH_BLOCKED) {
+                fprintf(stderr, "Path Error: (%u, %u) is %d after %s, not blocked\n", x, y, map.at(x, y), how);
+                return false;
+            }
+        }
+        if (map.at(3, 1) != -9 || map.downhill(wall - 1, 1) == std::make_pair<int16_t, int16_t>(wall, 1)) {
+            fprintf(stderr, "Path Error: wrong distances in front of the wall after %s\n", how);
+            return false;
+        }
+        return true;
+    };
+
+    map.compute(cost);
+    if (!check("compute")) return false;
+
+    // a gap opened in the wall and shut again
+    cost.at(wall, 4) = 1;
+    map.changed(cost, wall, 4);
+    cost.at(wall, 4) = PATH_BLOCKED;
+    map.changed(cost, wall, 4);
+
+    return check("changed");
+}
+
+
+int main() {
+
+    if (!check_negative_goal()) return 1;
+
+    TileGrid tiles(MAP_SIZE, MAP_SIZE);
+    Dungeon::generate_floor(tiles, 42, 0);
+
+    CostGrid cost(MAP_SIZE, MAP_SIZE);
+    costs_from_tiles(tiles, cost);
+
+    std::vector<Pair<int16_t>> floor;
+    for (int16_t y = 0; y < MAP_SIZE; y++)
+    for (int16_t x = 0; x < MAP_SIZE; x++)
+        if (tiles.at(x, y) == Dungeon::FLOOR) floor.push_back(std::make_pair(x, y));
+
+    Rng rng(7);
+    auto random_floor = [&]() { return floor[rng.range(0, floor.size())]; };
+
+    const Pair<int16_t> player = random_floor();
+
+    printf("%ux%u map, %zu floor cells, %zu actors\n\n", MAP_SIZE, MAP_SIZE, floor.size(), ACTORS);
+
+
+    // Full computation
+    DijkstraMap chase(MAP_SIZE, MAP_SIZE);
+    chase.add_goal(player.first, player.second);
+
+    Clock::time_point start = Clock::now();
+    chase.compute(cost);
+    printf("%-32s %10.1f us\n", "chase map (full)", elapsed_us(start));
+
+
+    // Incremental updates: a random cell is walled up and then opened again
+    double changed_total = 0;
+    for (size_t i = 0; i < TICKS; i++) {
+        const Pair<int16_t> door = random_floor();
+        if (door == player) continue;
+
+        cost.at(door.first, door.second) = PATH_BLOCKED;
+        start = Clock::now();
+        chase.changed(cost, door.first, door.second);
+        changed_total += elapsed_us(start);
+
+        cost.at(door.first, door.second) = 1;
+        start = Clock::now();
+        chase.changed(cost, door.first, door.second);
+        changed_total += elapsed_us(start);
+    }
+    printf("%-32s %10.1f us\n", "chase map (cell changed)", changed_total / (2 * TICKS));
+
+
+    // Every actor steps towards the player, every tick
+    std::vector<Pair<int16_t>> actors(ACTORS);
+    for (Pair<int16_t> &a : actors) a = random_floor();
+
+    start = Clock::now();
+    for (size_t t = 0; t < TICKS; t++)
+        for (Pair<int16_t> &a : actors)
+            a = chase.downhill(a.first, a.second);
+    printf("%-32s %10.1f us\n", "all actors step (per tick)", elapsed_us(start) / TICKS);
+
+
+    // Independent maps in parallel (e.g. one per faction or goal type)
+    std::vector<DijkstraMap> maps(8, DijkstraMap(MAP_SIZE, MAP_SIZE));
+    std::vector<DijkstraMap *> map_ptrs;
+    for (DijkstraMap &m : maps) {
+        const Pair<int16_t> goal = random_floor();
+        m.add_goal(goal.first, goal.second);
+        map_ptrs.push_back(&m);
+    }
+
+    for (uint8_t threads : { 1, 4 }) {
+        start = Clock::now();
+        DijkstraMap::compute_all(map_ptrs, cost, threads);
+        char label[32];
+        snprintf(label, sizeof label, "8 maps, %u thread(s)", threads);
+        printf("%-32s %10.1f us\n", label, elapsed_us(start));
+    }
+
+
+    // Single A* queries from actors to the player
+    PathFinder finder(MAP_SIZE, MAP_SIZE);
+    std::vector<Pair<int16_t>> path;
+    std::vector<double> times;
+
+    for (size_t i = 0; i < ACTORS; i++) {
+        start = Clock::now();
+        finder.find(cost, actors[i], player, path);
+        times.push_back(elapsed_us(start));
+    }
+
+    std::sort(times.begin(), times.end());
+    printf("%-32s %10.1f us\n", "A* query (p50)", times[times.size() / 2]);
+    printf("%-32s %10.1f us\n", "A* query (p99)", times[times.size() * 99 / 100]);
+
+    return 0;
+}
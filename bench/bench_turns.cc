@@ -0,0 +1,179 @@
+
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "types.h"
+#include "dungeon.h"
+#include "entity.h"
+#include "scheduler.h"
+
+
+/*
+    Benchmark for the turn scheduler.
+
+    10,000 actors of assorted speeds take a million turns
+    between them, with some of them being slowed or hasted
+    and some dying and being replaced along the way. The same
+    turns are then run through a binary heap (re-pushing on
+    every speed change) for comparison, and every tick's
+    actors are split into conflict free waves.
+*/
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+
+static constexpr size_t  ACTORS = 10000u;
+static constexpr size_t  TURNS  = 1000000u;
+static constexpr int16_t WORLD  = 512;
+
+
+static uint16_t random_speed(Rng &rng) {
+    return (uint16_t)rng.range(25, 200);
+}
+
+
+int main() {
+
+    EntityStore store;
+    std::vector<Entity> actors;
+
+    Rng rng(3);
+    for (size_t i = 0; i < ACTORS; i++) {
+        const Entity e = store.create();
+        store.positions.add(e, std::make_pair((int16_t)rng.range(0, WORLD), (int16_t)rng.range(0, WORLD)));
+        actors.push_back(e);
+    }
+
+    printf("%zu actors, %zu turns\n\n", ACTORS, TURNS);
+
+
+    // The calendar queue
+    {
+        Rng rng(5);
+        TurnScheduler turns;
+        for (Entity e : actors) turns.add(e, random_speed(rng), rng.range(0, TURN_ENERGY));
+
+        std::vector<Entity> due;
+        size_t taken = 0, ticks = 0, changes = 0;
+
+        Clock::time_point start = Clock::now();
+        while (taken < TURNS && turns.next(due)) {
+            ticks++;
+            for (Entity e : due) {
+                turns.spend(e, TURN_ENERGY);
+                taken++;
+
+                if (rng.chance(2)) {
+                    // a random actor is slowed or hasted
+                    turns.set_speed(actors[rng.range(0, ACTORS)], random_speed(rng));
+                    changes++;
+                }
+                if (rng.chance(1)) {
+                    // someone dies, and someone new arrives
+                    const uint32_t i = rng.range(0, ACTORS);
+                    turns.remove(actors[i]);
+                    store.destroy(actors[i]);
+                    actors[i] = store.create();
+                    store.positions.add(actors[i], std::make_pair((int16_t)rng.range(0, WORLD), (int16_t)rng.range(0, WORLD)));
+                    turns.add(actors[i], random_speed(rng));
+                }
+            }
+        }
+        const double us = elapsed_us(start);
+
+        printf("%-28s %10.1f ns/turn  (%zu ticks, %zu speed changes)\n",
+               "calendar queue", us * 1000 / taken, ticks, changes);
+    }
+
+
+    // A binary heap for comparison: speed changes push a new entry,
+    // and entries which no longer match their actor are skipped
+    {
+        Rng rng(5);
+
+        struct Turn { uint32_t due, actor, version; };
+        auto later = [](const Turn &a, const Turn &b) { return a.due > b.due; };
+        std::priority_queue<Turn, std::vector<Turn>, std::function<bool(const Turn &, const Turn &)>> heap(later);
+
+        std::vector<uint32_t> version(ACTORS, 0), due_at(ACTORS), speed(ACTORS), since(ACTORS);
+        std::vector<int32_t>  energy(ACTORS);
+
+        auto schedule = [&](uint32_t a, uint32_t now) {
+            const int32_t needed = TURN_ENERGY - energy[a];
+            due_at[a] = now + (needed <= 0 ? 0 : (needed + speed[a] - 1) / speed[a]);
+            since[a]  = now;
+            heap.push(Turn{ due_at[a], a, ++version[a] });
+        };
+
+        for (uint32_t a = 0; a < ACTORS; a++) {
+            speed[a]  = random_speed(rng);
+            energy[a] = rng.range(0, TURN_ENERGY);
+            schedule(a, 0);
+        }
+
+        size_t taken = 0;
+        Clock::time_point start = Clock::now();
+        while (taken < TURNS && !heap.empty()) {
+            const Turn t = heap.top();
+            heap.pop();
+            if (t.version != version[t.actor]) continue;
+
+            energy[t.actor] += speed[t.actor] * (t.due - since[t.actor]) - TURN_ENERGY;
+            schedule(t.actor, t.due);
+            taken++;
+
+            if (rng.chance(2)) {
+                const uint32_t a = rng.range(0, ACTORS);
+                energy[a] += speed[a] * (t.due - since[a]);
+                speed[a] = random_speed(rng);
+                schedule(a, t.due);
+            }
+            if (rng.chance(1)) {
+                const uint32_t a = rng.range(0, ACTORS);
+                energy[a] = 0;
+                speed[a]  = random_speed(rng);
+                schedule(a, t.due);
+            }
+        }
+        const double us = elapsed_us(start);
+
+        printf("%-28s %10.1f ns/turn\n", "binary heap", us * 1000 / taken);
+    }
+
+
+    // Splitting each tick's actors into waves which can't conflict
+    {
+        Rng rng(5);
+        TurnScheduler turns;
+        TurnBatcher batcher(WORLD, WORLD);
+        for (Entity e : actors) turns.add(e, random_speed(rng), rng.range(0, TURN_ENERGY));
+
+        std::vector<Entity> due;
+        std::vector<std::vector<Entity>> waves;
+        size_t taken = 0, ticks = 0, wave_count = 0;
+        double split_us = 0;
+
+        while (taken < TURNS && turns.next(due)) {
+            Clock::time_point start = Clock::now();
+            batcher.split(due, store.positions, waves);
+            split_us += elapsed_us(start);
+
+            ticks++;
+            wave_count += waves.size();
+            for (Entity e : due) { turns.spend(e, TURN_ENERGY); taken++; }
+        }
+
+        printf("%-28s %10.1f ns/turn  (%.2f waves per tick, %.1f actors per tick)\n",
+               "conflict free waves", split_us * 1000 / taken, (double)wave_count / ticks, (double)taken / ticks);
+    }
+
+    return 0;
+}
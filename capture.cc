@@ -0,0 +1,207 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "capture.h"
+
+
+
+/* Implementation of FrameCapture */
+
+
+static bool ends_with(const std::string &s, const char *suffix) {
+    const size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+
+/*
+    Split a pattern like `shots/%05u.bmp` around its one conversion,
+    which may have a width (padded with zeros if it starts with 0).
+    The pattern is never used as a format itself, since it comes
+    from the command line.
+*/
+static bool split_pattern(const std::string &pattern, std::string &prefix, std::string &suffix,
+                          int &digits, bool &zeros) {
+
+    const size_t start = pattern.find('%');
+    if (start == std::string::npos) return false;
+
+    size_t i = start + 1;
+
+    zeros = i < pattern.size() && pattern[i] == '0';
+    if (zeros) i++;
+
+    digits = 0;
+    while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9' && digits < 100)
+        digits = digits * 10 + (pattern[i++] - '0');
+
+    if (i >= pattern.size() || (pattern[i] != 'u' && pattern[i] != 'd')) return false;
+
+    prefix = pattern.substr(0, start);
+    suffix = pattern.substr(i + 1);
+
+    return suffix.find('%') == std::string::npos;
+}
+
+
+FrameCapture::FrameCapture(const std::string &path, uint16_t width, uint16_t height, uint8_t buffers)
+    : pattern{path}, raw{ends_with(path, ".raw")}, stream{nullptr}
+    , digits{0}, zeros{false}
+    , width{width}, height{height}
+    , frames(buffers ? buffers : 1)
+    , _captured{0}, _dropped{0}
+    , stopping{false}, failed{false} {
+
+    if (raw) {
+        stream = fopen(path.c_str(), "wb");
+        if (stream == nullptr) {
+            fprintf(stderr, "Capture Error: cannot write %s: %s\n", path.c_str(), strerror(errno));
+            failed = true;
+        }
+    } else {
+        if (path.find('%') == std::string::npos) pattern += "%05u.bmp";
+
+        if (!split_pattern(pattern, prefix, suffix, digits, zeros)) {
+            fprintf(stderr, "Capture Error: %s needs exactly one number, like %%05u, and no other %%\n", path.c_str());
+            failed = true;
+        }
+    }
+
+    // every buffer is allocated up front, so capturing never allocates
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].pixels.resize((size_t)width * height);
+        idle.push_back(i);
+    }
+
+    worker = std::thread(&FrameCapture::work, this);
+}
+
+
+FrameCapture::~FrameCapture() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    if (stream) fclose(stream);
+
+    fprintf(stderr, "Captured %u frames to %s (%u dropped)\n", _captured, pattern.c_str(), _dropped);
+}
+
+
+uint32_t FrameCapture::captured() const { return _captured; }
+uint32_t FrameCapture::dropped()  const { return _dropped;  }
+
+
+bool FrameCapture::grab() {
+
+    size_t i;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (failed) return false;
+
+        if (idle.empty()) {
+            _dropped++;
+            return false;
+        }
+
+        i = idle.back();
+        idle.pop_back();
+    }
+
+    // the buffer is ours alone until it is queued, so no lock is needed to fill it
+    Frame &frame = frames[i];
+    bool ok;
+
+    if (const RenderBackend *backend = render_config.backend()) {
+        ok = backend->read(frame.pixels.data(), width, height);
+    } else {
+        ok = SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888,
+                                  frame.pixels.data(), width * 4) == 0;
+        if (!ok) fprintf(stderr, "SDL_RenderReadPixels Error: %s\n", SDL_GetError());
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ok) {
+            idle.push_back(i);
+            return false;
+        }
+
+        frame.number = _captured++;
+        queued.push_back(i);
+    }
+    wake.notify_one();
+
+    return true;
+}
+
+
+void FrameCapture::work() {
+
+    for (;;) {
+
+        size_t i;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || !queued.empty(); });
+
+            // whatever was captured is still written out before stopping
+            if (queued.empty()) return;
+
+            i = queued.front();
+            queued.pop_front();
+        }
+
+        const bool ok = failed || write(frames[i]);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ok) failed = true;
+        idle.push_back(i);
+    }
+}
+
+
+bool FrameCapture::write(const Frame &frame) {
+
+    const size_t size = frame.pixels.size() * sizeof(uint32_t);
+
+    if (raw) {
+        if (fwrite(frame.pixels.data(), 1, size, stream) != size) {
+            fprintf(stderr, "Capture Error: cannot write %s: %s\n", pattern.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    char number[128];
+    snprintf(number, sizeof(number), zeros ? "%0*u" : "%*u", digits, frame.number);
+
+    const std::string path = prefix + number + suffix;
+
+    // the surface only borrows the pixels, which the worker has to itself until handed back
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)frame.pixels.data(), width, height,
+                                                              32, width * 4, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormatFrom Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    const bool ok = SDL_SaveBMP(surface, path.c_str()) == 0;
+    if (!ok) fprintf(stderr, "SDL_SaveBMP Error: %s\n", SDL_GetError());
+
+    SDL_FreeSurface(surface);
+    return ok;
+}
@@ -0,0 +1,88 @@
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+
+
+/*
+    Records frames as they are drawn, without ever making the
+    game wait on the disk: each frame is copied into one of a
+    few reusable buffers, and a worker thread writes the buffers
+    out and hands them back. Should the disk fall behind and
+    every buffer be waiting, frames are dropped rather than
+    the frame rate.
+
+    A `path` ending in `.raw` has every frame appended to it,
+    one after another, as ARGB8888 pixels (`bgra` to ffmpeg,
+    on little endian machines). Any other path is a pattern
+    for a numbered BMP file per frame, like `shots/%05u.bmp`,
+    with the number put on the end if the pattern has none.
+    A pattern with anything but one `%u` or `%d` (with an
+    optional width) is refused, and nothing is captured.
+*/
+class FrameCapture {
+public:
+
+    FrameCapture(const std::string &path, uint16_t width, uint16_t height, uint8_t buffers = 4);
+
+    /* Writes out every frame still waiting first */
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    /*
+        Copy the frame drawn so far, from the render backend if
+        there is one and the SDL renderer otherwise. Must be
+        called on the render thread, before the frame is shown.
+        Returns false if the frame was not captured.
+    */
+    bool grab();
+
+    /* The number of frames captured, and dropped for want of a buffer */
+    uint32_t captured() const;
+    uint32_t dropped()  const;
+
+private:
+
+    struct Frame {
+        std::vector<uint32_t> pixels;
+        uint32_t              number;
+    };
+
+    void work();
+    bool write(const Frame &);
+
+    std::string pattern;
+    bool        raw;
+    FILE       *stream;
+
+    // a BMP path is the prefix, the frame number, then the suffix
+    std::string prefix, suffix;
+    int         digits;
+    bool        zeros;
+
+    uint16_t width, height;
+
+    std::vector<Frame> frames;
+
+    std::mutex              lock;
+    std::condition_variable wake;
+
+    std::vector<size_t> idle;   // free to be captured into
+    std::deque<size_t>  queued; // waiting to be written, oldest first
+
+    uint32_t _captured, _dropped;
+    bool     stopping, failed;
+
+    std::thread worker;
+
+};
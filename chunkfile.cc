@@ -0,0 +1,424 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+    #include <stdlib.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "types.h"
+#include "world.h"
+#include "chunkfile.h"
+
+
+
+/*
+    Layout constants. All integers are little endian.
+
+    header:  "IVTW" u16 version, u16 chunk size,
+             u16 chunks wide, u16 chunks high, u32 reserved
+    index:   u32 offset, u16 length, u8 encoding, u8 bits   (per chunk)
+    data:    encoded chunks, in index order
+*/
+
+static constexpr char     CHUNK_FILE_MAGIC[4]   = { 'I', 'V', 'T', 'W' };
+static constexpr uint16_t CHUNK_FILE_VERSION    = 1u;
+static constexpr size_t   CHUNK_FILE_HEADER     = 16u;
+static constexpr size_t   CHUNK_FILE_INDEX_ENTRY = 8u;
+
+
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p,     v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+
+
+/*
+    Chunk encoding
+*/
+
+
+/* The number of bits needed to index a palette of `count` tiles */
+static uint8_t packed_bits(size_t count) {
+    if (count <= 2) return 1;
+    if (count <= 4) return 2;
+    return 4;
+}
+
+
+/* Append the smallest encoding of `c` to `out`, returning its kind and bit width */
+static ChunkEncoding encode_chunk(const Chunk &c, std::vector<uint8_t> &out, uint8_t &bits) {
+
+    // Collect the distinct tiles used, in order of first appearance
+    int16_t palette_index[256];
+    uint8_t palette[16];
+    size_t  palette_size = 0;
+
+    memset(palette_index, -1, sizeof(palette_index));
+
+    for (size_t i = 0; i < CHUNK_TILES; i++) {
+        uint8_t t = (uint8_t)c.tiles[i];
+        if (palette_index[t] < 0) {
+            if (palette_size < 16) palette[palette_size] = t;
+            palette_index[t] = palette_size++;
+        }
+    }
+
+    // Measure the RLE encoding (runs are capped at 256 tiles)
+    size_t rle_size = 0;
+    for (size_t i = 0; i < CHUNK_TILES; ) {
+        size_t run = 1;
+        while (i + run < CHUNK_TILES && run < 256 && c.tiles[i + run] == c.tiles[i]) run++;
+        rle_size += 2;
+        i += run;
+    }
+
+    bits = 0;
+
+    if (palette_size == 1) {
+        out.push_back((uint8_t)c.tiles[0]);
+        return ChunkEncoding::FILL;
+    }
+
+    size_t packed_size = palette_size <= 16
+        ? 1 + palette_size + CHUNK_TILES * packed_bits(palette_size) / 8
+        : SIZE_MAX;
+
+    if (packed_size <= rle_size && packed_size < CHUNK_TILES) {
+
+        bits = packed_bits(palette_size);
+        out.push_back((uint8_t)palette_size);
+        out.insert(out.end(), palette, palette + palette_size);
+
+        // pack indices low bits first, several to a byte
+        const uint8_t per_byte = 8 / bits;
+        for (size_t i = 0; i < CHUNK_TILES; i += per_byte) {
+            uint8_t byte = 0;
+            for (uint8_t k = 0; k < per_byte; k++) {
+                byte |= palette_index[(uint8_t)c.tiles[i + k]] << (k * bits);
+            }
+            out.push_back(byte);
+        }
+
+        return ChunkEncoding::PACKED;
+    }
+
+    if (rle_size < CHUNK_TILES) {
+
+        for (size_t i = 0; i < CHUNK_TILES; ) {
+            size_t run = 1;
+            while (i + run < CHUNK_TILES && run < 256 && c.tiles[i + run] == c.tiles[i]) run++;
+            out.push_back((uint8_t)(run - 1));
+            out.push_back((uint8_t)c.tiles[i]);
+            i += run;
+        }
+
+        return ChunkEncoding::RLE;
+    }
+
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(c.tiles);
+    out.insert(out.end(), raw, raw + CHUNK_TILES);
+
+    return ChunkEncoding::RAW;
+}
+
+
+/* Decode a chunk, checking that the data can't write or read out of bounds */
+static bool decode_chunk(ChunkEncoding enc, uint8_t bits, const uint8_t *data, size_t length, Chunk &out) {
+
+    uint8_t *tiles = reinterpret_cast<uint8_t *>(out.tiles);
+
+    switch (enc) {
+
+    case ChunkEncoding::FILL:
+        if (length != 1) return false;
+        memset(tiles, data[0], CHUNK_TILES);
+        return true;
+
+    case ChunkEncoding::PACKED: {
+        if (bits != 1 && bits != 2 && bits != 4) return false;
+        if (length < 1) return false;
+
+        const size_t palette_size = data[0];
+        const uint8_t *palette = data + 1;
+        const uint8_t *packed  = palette + palette_size;
+        const uint8_t  mask    = (1u << bits) - 1;
+        const uint8_t  per_byte = 8 / bits;
+
+        if (length != 1 + palette_size + CHUNK_TILES / per_byte) return false;
+
+        for (size_t i = 0; i < CHUNK_TILES; i++) {
+            uint8_t idx = (packed[i / per_byte] >> ((i % per_byte) * bits)) & mask;
+            if (idx >= palette_size) return false;
+            tiles[i] = palette[idx];
+        }
+        return true;
+    }
+
+    case ChunkEncoding::RLE: {
+        if (length % 2) return false;
+
+        size_t pos = 0;
+        for (size_t i = 0; i < length; i += 2) {
+            size_t run = (size_t)data[i] + 1;
+            if (pos + run > CHUNK_TILES) return false;
+            memset(tiles + pos, data[i + 1], run);
+            pos += run;
+        }
+        return pos == CHUNK_TILES;
+    }
+
+    case ChunkEncoding::RAW:
+        if (length != CHUNK_TILES) return false;
+        memcpy(tiles, data, CHUNK_TILES);
+        return true;
+
+    }
+
+    return false;
+}
+
+
+
+/* Implementation of ChunkFile */
+
+
+ChunkFile::ChunkFile()
+    : base{nullptr}, size{0}, _chunks_wide{0}, _chunks_high{0}, mapped{false} { }
+
+ChunkFile::~ChunkFile() { close(); }
+
+
+bool ChunkFile::open(const std::string &path) {
+
+    close();
+
+#ifdef _WIN32
+
+    // No mmap here, so read the file in one go instead.
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "ChunkFile Error: could not open %s\n", path.c_str());
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    if (buffer == nullptr || fread(buffer, 1, size, f) != size) {
+        fprintf(stderr, "ChunkFile Error: could not read %s\n", path.c_str());
+        free(buffer);
+        fclose(f);
+        size = 0;
+        return false;
+    }
+
+    fclose(f);
+    base = buffer;
+
+#else
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ChunkFile Error: could not open %s\n", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "ChunkFile Error: could not stat %s\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "ChunkFile Error: could not map %s\n", path.c_str());
+        return false;
+    }
+
+    // chunks are decoded in whatever order the game wants them
+    madvise(addr, st.st_size, MADV_RANDOM);
+
+    base = static_cast<const uint8_t *>(addr);
+    size = st.st_size;
+
+#endif
+
+    mapped = true;
+
+
+    /* Only the header is validated here; index entries are checked as they are used */
+
+    if (size < CHUNK_FILE_HEADER || memcmp(base, CHUNK_FILE_MAGIC, 4) != 0) {
+        fprintf(stderr, "ChunkFile Error: %s is not a world file\n", path.c_str());
+        close();
+        return false;
+    }
+
+    if (get_u16(base + 4) != CHUNK_FILE_VERSION || get_u16(base + 6) != CHUNK_SIZE) {
+        fprintf(stderr, "ChunkFile Error: %s has an unsupported version or chunk size\n", path.c_str());
+        close();
+        return false;
+    }
+
+    _chunks_wide = get_u16(base + 8);
+    _chunks_high = get_u16(base + 10);
+
+    if (CHUNK_FILE_HEADER + (size_t)_chunks_wide * _chunks_high * CHUNK_FILE_INDEX_ENTRY > size) {
+        fprintf(stderr, "ChunkFile Error: %s has a truncated index\n", path.c_str());
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void ChunkFile::close() {
+
+    if (mapped) {
+#ifdef _WIN32
+        free(const_cast<uint8_t *>(base));
+#else
+        munmap(const_cast<uint8_t *>(base), size);
+#endif
+    }
+
+    base = nullptr;
+    size = 0;
+    _chunks_wide = _chunks_high = 0;
+    mapped = false;
+}
+
+
+bool ChunkFile::is_open() const { return mapped; }
+
+uint16_t ChunkFile::chunks_wide() const { return _chunks_wide; }
+uint16_t ChunkFile::chunks_high() const { return _chunks_high; }
+
+
+bool ChunkFile::load(uint16_t cx, uint16_t cy, Chunk &out) {
+
+    if (!mapped || cx >= _chunks_wide || cy >= _chunks_high)
+        return false;
+
+    const uint8_t *entry = base + CHUNK_FILE_HEADER
+                         + ((size_t)cy * _chunks_wide + cx) * CHUNK_FILE_INDEX_ENTRY;
+
+    const uint32_t offset = get_u32(entry);
+    const uint16_t length = get_u16(entry + 4);
+    const ChunkEncoding enc = ChunkEncoding(entry[6]);
+    const uint8_t  bits   = entry[7];
+
+    if ((size_t)offset + length > size || length == 0) {
+        fprintf(stderr, "ChunkFile Error: chunk (%u, %u) is out of bounds\n", cx, cy);
+        return false;
+    }
+
+    if (!decode_chunk(enc, bits, base + offset, length, out)) {
+        fprintf(stderr, "ChunkFile Error: chunk (%u, %u) is corrupt\n", cx, cy);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/* Saving */
+
+
+bool save_world(const World &world, const std::string &path) {
+
+    const size_t count = (size_t)world.chunks_wide() * world.chunks_high();
+    const size_t data_start = CHUNK_FILE_HEADER + count * CHUNK_FILE_INDEX_ENTRY;
+
+    // Encode everything into one buffer so it can be written in one call.
+    // Most chunks are expected to be a handful of bytes, so reserve a little
+    // for each and let the vector grow for the rest.
+    std::vector<uint8_t> buffer(data_start);
+    buffer.reserve(data_start + count * 64);
+
+    memcpy(&buffer[0], CHUNK_FILE_MAGIC, 4);
+    put_u16(&buffer[4],  CHUNK_FILE_VERSION);
+    put_u16(&buffer[6],  CHUNK_SIZE);
+    put_u16(&buffer[8],  world.chunks_wide());
+    put_u16(&buffer[10], world.chunks_high());
+    put_u32(&buffer[12], 0);
+
+    Chunk scratch;
+
+    for (uint16_t cy = 0; cy < world.chunks_high(); cy++)
+    for (uint16_t cx = 0; cx < world.chunks_wide(); cx++) {
+
+        const Chunk &c = world.peek(cx, cy, scratch);
+
+        const size_t offset = buffer.size();
+        uint8_t bits;
+        ChunkEncoding enc = encode_chunk(c, buffer, bits);
+
+        if (buffer.size() > UINT32_MAX) {
+            fprintf(stderr, "save_world Error: world is too large to save\n");
+            return false;
+        }
+
+        uint8_t *entry = &buffer[CHUNK_FILE_HEADER + ((size_t)cy * world.chunks_wide() + cx) * CHUNK_FILE_INDEX_ENTRY];
+        put_u32(entry,     (uint32_t)offset);
+        put_u16(entry + 4, (uint16_t)(buffer.size() - offset));
+        entry[6] = (uint8_t)enc;
+        entry[7] = bits;
+    }
+
+
+    // Write to a temporary file and rename over the old one, so that
+    // a crash mid-save (or a mapping of the old file) is never left half written.
+    const std::string tmp_path = path + ".tmp";
+
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        fprintf(stderr, "save_world Error: could not open %s\n", tmp_path.c_str());
+        return false;
+    }
+
+    // a full disk may only show when the last of the buffer is flushed, on closing
+    const bool written = fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+    if (fclose(f) != 0 || !written) {
+        fprintf(stderr, "save_world Error: could not write %s\n", tmp_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "save_world Error: could not replace %s\n", path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+
+#pragma once
+
+#include <string>
+
+#include "types.h"
+#include "world.h"
+
+
+/*
+    On-disk format for saved worlds.
+
+    A small header is followed by an index holding one
+    fixed-size entry per chunk, and then the encoded chunks
+    themselves. Each chunk is stored with whichever of the
+    encodings below is smallest for its contents, so that
+    mostly uniform dungeon floors take only a few bytes.
+
+    Nothing is decoded when a file is opened; the file is
+    mapped into memory and each chunk is only decoded
+    the first time the world asks for it.
+*/
+
+
+/* The ways a single chunk may be encoded */
+enum class ChunkEncoding : uint8_t {
+    FILL,   // a single tile repeated across the whole chunk
+    PACKED, // a small palette of tiles, with 1, 2 or 4 bit indices
+    RLE,    // (run length - 1, tile) byte pairs
+    RAW,    // one byte per tile
+};
+
+
+/*
+    A saved world, memory mapped and decoded lazily.
+    Can be handed to a `World` as its chunk source.
+*/
+class ChunkFile : public ChunkSource {
+public:
+
+    ChunkFile();
+    ~ChunkFile();
+
+    ChunkFile(const ChunkFile &) = delete;
+    ChunkFile &operator=(const ChunkFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool is_open() const;
+
+    uint16_t chunks_wide() const;
+    uint16_t chunks_high() const;
+
+    bool load(uint16_t cx, uint16_t cy, Chunk &out) override;
+
+private:
+
+    const uint8_t *base;
+    size_t         size;
+
+    uint16_t _chunks_wide, _chunks_high;
+
+    bool mapped;
+
+};
+
+
+/*
+    Encode every chunk of the world and write
+    it to `path`, replacing any previous file atomically.
+*/
+bool save_world(const World &, const std::string &path);
@@ -0,0 +1,356 @@
+
+#include <algorithm>
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+#include "autotile.h"
+#include "dungeon.h"
+
+
+
+/*
+    Rooms and corridors
+*/
+
+
+struct Room {
+    int x, y, w, h;
+
+    int center_x() const { return x + w / 2; }
+    int center_y() const { return y + h / 2; }
+
+};
+
+
+/* Whether the room (or the ring around it) would touch anything already carved */
+static bool room_fits(const TileGrid &grid, const Room &r) {
+    for (int y = r.y - 1; y <= r.y + r.h; y++) {
+        const Tile *row = grid.row(y);
+        for (int x = r.x - 1; x <= r.x + r.w; x++)
+            if (row[x] != Dungeon::ROCK) return false;
+    }
+    return true;
+}
+
+
+static void carve_room(TileGrid &grid, const Room &r) {
+    for (int y = r.y; y < r.y + r.h; y++)
+        std::fill(grid.row(y) + r.x, grid.row(y) + r.x + r.w, Dungeon::FLOOR);
+}
+
+static void carve_h(TileGrid &grid, int x0, int x1, int y) {
+    if (x0 > x1) std::swap(x0, x1);
+    std::fill(grid.row(y) + x0, grid.row(y) + x1 + 1, Dungeon::FLOOR);
+}
+
+static void carve_v(TileGrid &grid, int y0, int y1, int x) {
+    if (y0 > y1) std::swap(y0, y1);
+    for (int y = y0; y <= y1; y++) grid.at(x, y) = Dungeon::FLOOR;
+}
+
+
+void Dungeon::rooms_and_corridors(TileGrid &grid, uint64_t seed) {
+
+    Rng rng(seed);
+
+    grid.fill(ROCK);
+
+    const int width  = grid.width();
+    const int height = grid.height();
+
+    // too small to fit even one room and its walls
+    if (width < 6 || height < 5) return;
+
+    const int max_w = std::min(12, width  - 2);
+    const int max_h = std::min(8,  height - 2);
+
+    const size_t max_rooms = std::max(2, width * height / 120);
+    const size_t attempts  = max_rooms * 4;
+
+    std::vector<Room> rooms;
+    rooms.reserve(max_rooms);
+
+    for (size_t i = 0; i < attempts && rooms.size() < max_rooms; i++) {
+
+        Room r;
+        r.w = rng.range(std::min(4, max_w), max_w + 1);
+        r.h = rng.range(std::min(3, max_h), max_h + 1);
+        r.x = rng.range(1, width  - r.w);
+        r.y = rng.range(1, height - r.h);
+
+        if (!room_fits(grid, r)) continue;
+
+        carve_room(grid, r);
+
+        // join each room up to the one before it
+        if (!rooms.empty()) {
+            const Room &prev = rooms.back();
+            if (rng.chance(50)) {
+                carve_h(grid, prev.center_x(), r.center_x(), prev.center_y());
+                carve_v(grid, prev.center_y(), r.center_y(), r.center_x());
+            } else {
+                carve_v(grid, prev.center_y(), r.center_y(), prev.center_x());
+                carve_h(grid, prev.center_x(), r.center_x(), r.center_y());
+            }
+        }
+
+        rooms.push_back(r);
+    }
+}
+
+
+
+/*
+    Cellular automata caves
+*/
+
+
+// Chance for each cell to start out as rock
+static constexpr uint8_t CAVE_FILL_PERCENT = 45u;
+
+// Number of smoothing steps to run
+static constexpr uint8_t CAVE_STEPS = 4u;
+
+
+/* Keep only the largest connected region of floor, filling in the rest */
+static void keep_largest_region(TileGrid &grid) {
+
+    const int width  = grid.width();
+    const int height = grid.height();
+
+    std::vector<int32_t>  label((size_t)width * height, -1);
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> sizes;
+
+    for (uint32_t start = 0; start < label.size(); start++) {
+
+        if (grid.data()[start] != Dungeon::FLOOR || label[start] >= 0) continue;
+
+        const int32_t id = sizes.size();
+        uint32_t size = 0;
+
+        stack.push_back(start);
+        label[start] = id;
+
+        while (!stack.empty()) {
+            uint32_t i = stack.back();
+            stack.pop_back();
+            size++;
+
+            const int x = i % width, y = i / width;
+            const uint32_t next[4] = { i - 1, i + 1, i - width, i + width };
+            const bool     ok[4]   = { x > 0, x < width - 1, y > 0, y < height - 1 };
+
+            for (int k = 0; k < 4; k++) {
+                if (ok[k] && label[next[k]] < 0 && grid.data()[next[k]] == Dungeon::FLOOR) {
+                    label[next[k]] = id;
+                    stack.push_back(next[k]);
+                }
+            }
+        }
+
+        sizes.push_back(size);
+    }
+
+    if (sizes.empty()) return;
+
+    const int32_t largest = std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+
+    for (size_t i = 0; i < label.size(); i++) {
+        if (label[i] >= 0 && label[i] != largest) grid.data()[i] = Dungeon::ROCK;
+    }
+}
+
+
+void Dungeon::caves(TileGrid &grid, uint64_t seed) {
+
+    Rng rng(seed);
+
+    const int width  = grid.width();
+    const int height = grid.height();
+
+    if (width < 3 || height < 3) {
+        grid.fill(ROCK);
+        return;
+    }
+
+    // Work on 0/1 rock flags so neighbor counts are just sums.
+    // The outermost ring is always rock.
+    Grid<uint8_t> rock(width, height, 1);
+    Grid<uint8_t> next(width, height, 1);
+
+    for (int y = 1; y < height - 1; y++)
+    for (int x = 1; x < width  - 1; x++)
+        rock.at(x, y) = rng.chance(CAVE_FILL_PERCENT);
+
+    // Column sums of three rows, reused for the three
+    // horizontal neighbors of each cell
+    std::vector<uint8_t> column(width);
+
+    for (uint8_t step = 0; step < CAVE_STEPS; step++) {
+
+        for (int y = 1; y < height - 1; y++) {
+
+            const uint8_t *above = rock.row(y - 1);
+            const uint8_t *here  = rock.row(y);
+            const uint8_t *below = rock.row(y + 1);
+
+            for (int x = 0; x < width; x++)
+                column[x] = above[x] + here[x] + below[x];
+
+            uint8_t *out = next.row(y);
+            for (int x = 1; x < width - 1; x++)
+                out[x] = (column[x - 1] + column[x] + column[x + 1]) >= 5;
+        }
+
+        std::swap(rock, next);
+    }
+
+    for (int y = 0; y < height; y++)
+    for (int x = 0; x < width;  x++)
+        grid.at(x, y) = rock.at(x, y) ? ROCK : FLOOR;
+
+    keep_largest_region(grid);
+}
+
+
+
+/*
+    Whole floors
+*/
+
+
+/* Turn all rock touching floor into walls, and connect the walls up */
+static void add_walls(TileGrid &grid) {
+
+    const int width  = grid.width();
+    const int height = grid.height();
+
+    for (int y = 0; y < height; y++)
+    for (int x = 0; x < width;  x++) {
+
+        if (grid.at(x, y) != Dungeon::ROCK) continue;
+
+        bool touches_floor = false;
+        for (int dy = -1; dy <= 1 && !touches_floor; dy++)
+        for (int dx = -1; dx <= 1 && !touches_floor; dx++) {
+            touches_floor = grid.in_bounds(x + dx, y + dy)
+                         && grid.at(x + dx, y + dy) == Dungeon::FLOOR;
+        }
+
+        if (touches_floor) grid.at(x, y) = Dungeon::WALL;
+    }
+
+    Autotile::bulk(grid);
+}
+
+
+void Dungeon::generate_floor(TileGrid &grid, uint64_t seed, uint32_t depth) {
+
+    // every floor gets its own stream, so floors can be
+    // generated in any order (or in parallel) with the same results
+    const uint64_t floor_seed = mix_seed(seed ^ mix_seed(depth));
+
+    Rng rng(floor_seed);
+
+    if (rng.chance(35)) {
+        caves(grid, rng.next());
+    } else {
+        rooms_and_corridors(grid, rng.next());
+    }
+
+    add_walls(grid);
+}
+
+
+
+/* Implementation of FloorPrefetcher */
+
+
+FloorPrefetcher::FloorPrefetcher(uint64_t seed, uint16_t width, uint16_t height, uint8_t threads, uint8_t ahead)
+    : seed{seed}, width{width}, height{height}, ahead{ahead}, stopping{false} {
+
+    for (uint8_t i = 0; i < std::max<uint8_t>(threads, 1); i++)
+        workers.push_back(std::thread(&FloorPrefetcher::work, this));
+}
+
+
+FloorPrefetcher::~FloorPrefetcher() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers) worker.join();
+}
+
+
+/* Queue a floor for generation, if it hasn't been already (lock must be held) */
+void FloorPrefetcher::request(uint32_t depth) {
+    if (requested.count(depth)) return;
+
+    requested.insert(depth);
+    queue.push_back(depth);
+    wake.notify_one();
+}
+
+
+TileGrid FloorPrefetcher::take(uint32_t depth) {
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    request(depth);
+
+    // if the floor is still waiting its turn, it goes first now
+    auto queued = std::find(queue.begin(), queue.end(), depth);
+    if (queued != queue.end() && queued != queue.begin()) {
+        queue.erase(queued);
+        queue.push_front(depth);
+    }
+
+    for (uint32_t d = depth + 1; d <= depth + ahead; d++)
+        request(d);
+
+    done.wait(guard, [&] { return ready.count(depth) != 0; });
+
+    TileGrid floor = std::move(ready[depth]);
+    ready.erase(depth);
+    requested.erase(depth);
+
+    // anything shallower has been passed by
+    while (!ready.empty() && ready.begin()->first < depth) {
+        requested.erase(ready.begin()->first);
+        ready.erase(ready.begin());
+    }
+
+    return floor;
+}
+
+
+void FloorPrefetcher::work() {
+
+    for (;;) {
+        uint32_t depth;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || !queue.empty(); });
+
+            if (stopping) return;
+
+            depth = queue.front();
+            queue.pop_front();
+        }
+
+        TileGrid floor(width, height);
+        Dungeon::generate_floor(floor, seed, depth);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ready.emplace(depth, std::move(floor));
+        }
+        done.notify_all();
+    }
+}
@@ -0,0 +1,82 @@
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+
+#include "types.h"
+#include "grid.h"
+#include "rng.h"
+
+
+namespace Dungeon {
+
+    // The tiles generated floors are made from. Walls are left
+    // as `BORDER_NONE` for the autotiler to connect up.
+    static constexpr Tile FLOOR = Tile::PUNCT_FSTOP;
+    static constexpr Tile WALL  = Tile::BORDER_NONE;
+    static constexpr Tile ROCK  = Tile::PUNCT_SPACE;
+
+    /* Rectangular rooms joined by L shaped corridors */
+    void rooms_and_corridors(TileGrid &, uint64_t seed);
+
+    /* Cellular automata caves, trimmed down to their largest open region */
+    void caves(TileGrid &, uint64_t seed);
+
+    /*
+        A complete floor: the layout for `depth` is picked
+        and generated from `seed`, then given finished walls.
+    */
+    void generate_floor(TileGrid &, uint64_t seed, uint32_t depth);
+
+}
+
+
+/*
+    Generates the floors the player is about to reach on
+    background threads, so that taking the stairs doesn't
+    have to wait for generation.
+*/
+class FloorPrefetcher {
+public:
+
+    FloorPrefetcher(uint64_t seed, uint16_t width, uint16_t height,
+                    uint8_t threads = 2, uint8_t ahead = 3);
+    ~FloorPrefetcher();
+
+    FloorPrefetcher(const FloorPrefetcher &) = delete;
+    FloorPrefetcher &operator=(const FloorPrefetcher &) = delete;
+
+    /*
+        The floor at `depth`, blocking only if it is not generated yet.
+        Also queues up the `ahead` floors after it.
+    */
+    TileGrid take(uint32_t depth);
+
+private:
+
+    void request(uint32_t depth);
+    void work();
+
+    const uint64_t seed;
+    const uint16_t width, height;
+    const uint8_t  ahead;
+
+    std::mutex              lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    std::deque<uint32_t>          queue;
+    std::set<uint32_t>            requested;
+    std::map<uint32_t, TileGrid>  ready;
+
+    bool stopping;
+
+    std::vector<std::thread> workers;
+
+};
@@ -0,0 +1,86 @@
+
+#include <vector>
+
+#include "types.h"
+#include "entity.h"
+
+
+
+/* Implementation of SparseSet */
+
+
+constexpr uint32_t SparseSet::NONE;
+
+
+uint32_t SparseSet::insert(uint32_t index) {
+    if (index >= sparse.size()) sparse.resize(index + 1, NONE);
+
+    sparse[index] = (uint32_t)dense.size();
+    dense.push_back(index);
+    return sparse[index];
+}
+
+
+uint32_t SparseSet::erase(uint32_t index) {
+    const uint32_t hole = sparse[index];
+    const uint32_t last = dense.back();
+
+    dense[hole]  = last;
+    sparse[last] = hole;
+
+    dense.pop_back();
+    sparse[index] = NONE;
+    return hole;
+}
+
+
+
+/* Implementation of EntityStore */
+
+
+EntityStore::EntityStore()
+    : live{0} { }
+
+
+Entity EntityStore::create() {
+    live++;
+
+    if (!free_indices.empty()) {
+        const uint32_t index = free_indices.back();
+        free_indices.pop_back();
+        return Entity{ index, generations[index] };
+    }
+
+    generations.push_back(0);
+    return Entity{ (uint32_t)(generations.size() - 1), 0 };
+}
+
+
+void EntityStore::destroy(Entity e) {
+    if (!alive(e)) return;
+
+    positions.remove(e);
+    glyphs.remove(e);
+    styles.remove(e);
+    health.remove(e);
+    energy.remove(e);
+
+    generations[e.index]++;
+    free_indices.push_back(e.index);
+    live--;
+}
+
+
+bool EntityStore::alive(Entity e) const {
+    return e.index < generations.size() && generations[e.index] == e.generation;
+}
+
+
+size_t EntityStore::count() const {
+    return live;
+}
+
+
+Entity EntityStore::handle(uint32_t index) const {
+    return Entity{ index, generations[index] };
+}
@@ -0,0 +1,251 @@
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#include "types.h"
+#include "style.h"
+
+
+/*
+    A handle to an entity. Indices are reused once an entity
+    is destroyed, but the generation is bumped each time, so a
+    stale handle never refers to whatever lives there now.
+*/
+struct Entity {
+
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const Entity &other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+// A handle which never refers to a live entity
+static constexpr Entity NO_ENTITY = { 0xFFFFFFFFu, 0u };
+
+
+
+/*
+    Styles can't be stored by value in components (they are
+    not assignable), so entities refer to them by their index
+    in a table of styles instead.
+*/
+typedef uint16_t StyleId;
+
+class StyleTable {
+public:
+
+    StyleId add(const Style &s) {
+        styles.push_back(s);
+        return (StyleId)(styles.size() - 1);
+    }
+
+    const Style &operator[](StyleId id) const { return styles[id]; }
+
+    size_t size() const { return styles.size(); }
+
+private:
+
+    std::vector<Style> styles;
+
+};
+
+
+
+/*
+    The entity indices which have some component: a sparse
+    array from entity index to position, and a dense array of
+    the indices back again. Removal swaps the last element
+    into the hole, so the dense array never has gaps.
+*/
+class SparseSet {
+public:
+
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    size_t size() const { return dense.size(); }
+
+    bool contains(uint32_t index) const {
+        return index < sparse.size() && sparse[index] != NONE;
+    }
+
+    /* The entity index at each position of the dense array */
+    const uint32_t *indices() const { return dense.data(); }
+
+protected:
+
+    /* Add `index` at the end, returning its position */
+    uint32_t insert(uint32_t index);
+
+    /* Remove `index`, returning the position the last element moved into */
+    uint32_t erase(uint32_t index);
+
+    std::vector<uint32_t> sparse;
+    std::vector<uint32_t> dense;
+
+};
+
+
+/*
+    A component of type T for some set of entities, stored
+    packed in the same order as the dense array of indices.
+    The generation of the entity which was given each value is
+    kept alongside it, so a stale handle finds nothing there.
+*/
+template <class T>
+class ComponentArray : public SparseSet {
+public:
+
+    bool has(Entity e) const {
+        return contains(e.index) && owners[sparse[e.index]] == e.generation;
+    }
+
+    /*
+        Give `e` this component, or replace the value it has. A
+        stale handle, whose index has been given to another entity
+        since, gets a scratch value and leaves that entity's alone.
+    */
+    T &add(Entity e, const T &value) {
+        if (contains(e.index)) {
+            if (owners[sparse[e.index]] != e.generation) return missing(e);
+            return values[sparse[e.index]] = value;
+        }
+        insert(e.index);
+        values.push_back(value);
+        owners.push_back(e.generation);
+        return values.back();
+    }
+
+    void remove(Entity e) {
+        if (!has(e)) return;
+        const uint32_t hole = erase(e.index);
+        values[hole] = values.back();
+        values.pop_back();
+        owners[hole] = owners.back();
+        owners.pop_back();
+    }
+
+    /* The component of `e`, or nullptr if it has none (or the handle is stale) */
+    T       *find(Entity e)       { return has(e) ? &values[sparse[e.index]] : nullptr; }
+    const T *find(Entity e) const { return has(e) ? &values[sparse[e.index]] : nullptr; }
+
+    /*
+        The component of `e`, which should have one. Anything
+        else (a stale handle included) gets a scratch value
+        rather than some other entity's component.
+    */
+    T       &get(Entity e)       { return has(e) ? values[sparse[e.index]] : missing(e); }
+    const T &get(Entity e) const { return has(e) ? values[sparse[e.index]] : missing(e); }
+
+    T       &by_index(uint32_t index)       { return values[sparse[index]]; }
+    const T &by_index(uint32_t index) const { return values[sparse[index]]; }
+
+    /* The packed values, in the order of `indices()` */
+    T       *data()       { return values.data(); }
+    const T *data() const { return values.data(); }
+
+private:
+
+    T &missing(Entity e) const {
+        fprintf(stderr, "Entity Error: %u (generation %u) has no such component\n", e.index, e.generation);
+        scratch = T();
+        return scratch;
+    }
+
+    std::vector<T>        values;
+    std::vector<uint32_t> owners; // the generation given each value
+
+    mutable T scratch;
+
+};
+
+
+
+/*
+    Every entity in a level and all of their components.
+
+    Each component lives in its own packed array, so systems
+    only touch the components they use; `each` visits the
+    entities having all of a set of components by walking the
+    smallest of their arrays.
+*/
+class EntityStore {
+public:
+
+    EntityStore();
+
+    Entity create();
+    void   destroy(Entity);
+
+    bool alive(Entity) const;
+
+    /* The number of live entities */
+    size_t count() const;
+
+    /* The current handle for a live entity index */
+    Entity handle(uint32_t index) const;
+
+    ComponentArray<Pair<int16_t>> positions;
+    ComponentArray<Tile>          glyphs;
+    ComponentArray<StyleId>       styles;
+    ComponentArray<int16_t>       health;
+    ComponentArray<int16_t>       energy;
+
+    /*
+        Call `f(entity, components...)` for every entity having all
+        of the given components. Components may be changed freely,
+        but none may be added or removed while iterating.
+    */
+    template <class F, class A, class... Rest>
+    void each(F f, ComponentArray<A> &first, ComponentArray<Rest> &... rest);
+
+private:
+
+    static bool all_contain(uint32_t) { return true; }
+
+    template <class S, class... Rest>
+    static bool all_contain(uint32_t index, const S &set, const Rest &... rest) {
+        return set.contains(index) && all_contain(index, rest...);
+    }
+
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> free_indices;
+
+    size_t live;
+
+};
+
+
+
+template <class F, class A, class... Rest>
+void EntityStore::each(F f, ComponentArray<A> &first, ComponentArray<Rest> &... rest) {
+
+    const SparseSet *sets[] = { &first, &rest... };
+
+    const SparseSet *driver = sets[0];
+    for (const SparseSet *s : sets)
+        if (s->size() < driver->size()) driver = s;
+
+    const uint32_t *indices = driver->indices();
+    const size_t    n       = driver->size();
+
+    if (driver == &first) {
+        // the first array's values are in step with the walk
+        A *values = first.data();
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t index = indices[i];
+            if (!all_contain(index, rest...)) continue;
+            f(Entity{ index, generations[index] }, values[i], rest.by_index(index)...);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t index = indices[i];
+            if (!all_contain(index, first, rest...)) continue;
+            f(Entity{ index, generations[index] }, first.by_index(index), rest.by_index(index)...);
+        }
+    }
+}
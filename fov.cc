@@ -0,0 +1,272 @@
+
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+#include "autotile.h"
+#include "fov.h"
+
+
+
+bool is_opaque(Tile t) {
+    return t == Tile::PLAIN_FILL || Autotile::is_border(t);
+}
+
+
+void opacity_from_tiles(const TileGrid &tiles, BitGrid &out) {
+    out.clear();
+    for (int y = 0; y < tiles.height(); y++) {
+        const Tile *row = tiles.row(y);
+        for (int x = 0; x < tiles.width(); x++)
+            if (is_opaque(row[x])) out.set(x, y);
+    }
+}
+
+
+void update_opacity(const TileGrid &tiles, BitGrid &out, int x, int y) {
+    if (is_opaque(tiles.at(x, y))) out.set(x, y);
+    else                           out.reset(x, y);
+}
+
+
+
+/*
+    Symmetric shadowcasting.
+
+    An octant is scanned row by row moving away from the viewer,
+    each row covering the columns between a start and end slope.
+    Walls narrow the slopes of the rows after them. Floors are
+    only visible when their center lies within the slopes, which
+    is what makes the result symmetric; walls are visible if any
+    part of them is.
+*/
+
+
+/* A slope of num / den, with den > 0 */
+struct Slope {
+    int32_t num, den;
+};
+
+struct Row {
+    int16_t depth;
+    Slope   start, end;
+};
+
+
+/* How each octant's (column, depth) maps onto (dx, dy) */
+static const int8_t OCTANT_TRANSFORM[8][4] = {
+    //  xx  xy  yx  yy
+    {  1,  0,  0, -1 }, // north, east side
+    { -1,  0,  0, -1 }, // north, west side
+    {  1,  0,  0,  1 }, // south, east side
+    { -1,  0,  0,  1 }, // south, west side
+    {  0,  1,  1,  0 }, // east, south side
+    {  0,  1, -1,  0 }, // east, north side
+    {  0, -1,  1,  0 }, // west, south side
+    {  0, -1, -1,  0 }, // west, north side
+};
+
+
+static int32_t floor_div(int32_t a, int32_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/* depth * slope, rounded to the nearest column with ties going up */
+static int32_t round_ties_up(int16_t depth, Slope s) {
+    return floor_div(2 * depth * s.num + s.den, 2 * s.den);
+}
+
+/* depth * slope, rounded to the nearest column with ties going down */
+static int32_t round_ties_down(int16_t depth, Slope s) {
+    return -floor_div(-(2 * depth * s.num - s.den), 2 * s.den);
+}
+
+/* The slope to the near edge of a cell */
+static Slope slope_of(int32_t col, int16_t depth) {
+    return Slope{ 2 * col - 1, 2 * depth };
+}
+
+static bool is_symmetric(const Row &row, int32_t col) {
+    return col * row.start.den >= row.depth * row.start.num
+        && col * row.end.den   <= row.depth * row.end.num;
+}
+
+
+/* Whether the octant contains the cell at offset (dx, dy) from the viewer */
+static bool octant_contains(uint8_t octant, int16_t dx, int16_t dy) {
+    const int8_t *m = OCTANT_TRANSFORM[octant];
+
+    // the transforms are orthogonal, so their inverse is their transpose
+    const int32_t col   = dx * m[0] + dy * m[2];
+    const int32_t depth = dx * m[1] + dy * m[3];
+
+    return depth > 0 && col >= 0 && col <= depth;
+}
+
+
+
+/* Implementation of Fov */
+
+
+Fov::Fov(uint16_t width, uint16_t height, uint8_t radius)
+    : ox{0}, oy{0}, _radius{radius}
+    , _visible(width, height), _remembered(width, height)
+    , window(2 * radius + 1, 2 * radius + 1)
+    , wx{0}, wy{0} {
+
+    for (BitGrid &octant : octants)
+        octant = BitGrid(2 * radius + 1, 2 * radius + 1);
+}
+
+
+const BitGrid &Fov::visible()    const { return _visible; }
+const BitGrid &Fov::remembered() const { return _remembered; }
+
+Pair<int16_t> Fov::origin() const { return std::make_pair(ox, oy); }
+uint8_t       Fov::radius() const { return _radius; }
+
+
+void Fov::forget() {
+    _remembered.clear();
+    _remembered.merge(_visible);
+}
+
+
+void Fov::cast(const BitGrid &opaque, uint8_t octant) {
+
+    const int8_t *m = OCTANT_TRANSFORM[octant];
+    const int32_t r = _radius;
+    const int32_t r2 = r * r + r; // a slightly rounder circle than r * r
+
+    BitGrid &out = octants[octant];
+    out.clear();
+
+    // the rows waiting to be scanned; kept across calls to avoid reallocating
+    static thread_local std::vector<Row> rows;
+    rows.clear();
+    rows.push_back(Row{ 1, Slope{ 0, 1 }, Slope{ 1, 1 } });
+
+    while (!rows.empty()) {
+
+        Row row = rows.back();
+        rows.pop_back();
+
+        if (row.depth > r) continue;
+
+        int32_t min_col = round_ties_up(row.depth, row.start);
+        int32_t max_col = round_ties_down(row.depth, row.end);
+        if (min_col < 0) min_col = 0;
+
+        // -1: nothing yet, 0: floor, 1: wall
+        int8_t prev = -1;
+
+        for (int32_t col = min_col; col <= max_col; col++) {
+
+            const int32_t dx = col * m[0] + row.depth * m[1];
+            const int32_t dy = col * m[2] + row.depth * m[3];
+            const int32_t x  = ox + dx;
+            const int32_t y  = oy + dy;
+
+            const bool wall = !opaque.in_bounds(x, y) || opaque.get(x, y);
+
+            if ((wall || is_symmetric(row, col)) && dx * dx + dy * dy <= r2) {
+                out.set(dx + r, dy + r);
+            }
+
+            if (prev == 1 && !wall) {
+                row.start = slope_of(col, row.depth);
+            }
+            if (prev == 0 && wall) {
+                rows.push_back(Row{ (int16_t)(row.depth + 1), row.start, slope_of(col, row.depth) });
+            }
+
+            prev = wall;
+        }
+
+        if (prev == 0) {
+            rows.push_back(Row{ (int16_t)(row.depth + 1), row.start, row.end });
+        }
+    }
+}
+
+
+/* Remove the last results from the map sized bitset */
+void Fov::unpublish() {
+    for (int j = 0; j < window.height(); j++) {
+        const uint64_t *words = window.row(j);
+        for (int w = 0; w < window.stride(); w++) {
+            uint64_t bits = words[w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (_visible.in_bounds(wx + i, wy + j)) _visible.reset(wx + i, wy + j);
+            }
+        }
+    }
+}
+
+
+/* Combine the octants, and copy them into the map sized bitsets */
+void Fov::publish() {
+
+    window.clear();
+    for (const BitGrid &octant : octants) window.merge(octant);
+    window.set(_radius, _radius);
+
+    wx = ox - _radius;
+    wy = oy - _radius;
+
+    for (int j = 0; j < window.height(); j++) {
+        const uint64_t *words = window.row(j);
+        for (int w = 0; w < window.stride(); w++) {
+            uint64_t bits = words[w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (_visible.in_bounds(wx + i, wy + j)) {
+                    _visible.set(wx + i, wy + j);
+                    _remembered.set(wx + i, wy + j);
+                }
+            }
+        }
+    }
+}
+
+
+void Fov::compute(const BitGrid &opaque, int16_t x, int16_t y) {
+    unpublish();
+
+    ox = x;
+    oy = y;
+    for (uint8_t o = 0; o < 8; o++) cast(opaque, o);
+
+    publish();
+}
+
+
+void Fov::move(const BitGrid &opaque, int16_t x, int16_t y) {
+    // Every octant is relative to the viewer, so any move
+    // means casting them all again; standing still is free.
+    if (x == ox && y == oy) return;
+    compute(opaque, x, y);
+}
+
+
+void Fov::changed(const BitGrid &opaque, int16_t x, int16_t y) {
+
+    const int16_t dx = x - ox;
+    const int16_t dy = y - oy;
+
+    if (dx < -_radius || dx > _radius || dy < -_radius || dy > _radius) return;
+
+    bool any = false;
+    for (uint8_t o = 0; o < 8; o++) {
+        if (octant_contains(o, dx, dy)) {
+            if (!any) unpublish();
+            cast(opaque, o);
+            any = true;
+        }
+    }
+
+    if (any) publish();
+}
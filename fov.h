@@ -0,0 +1,73 @@
+
+#pragma once
+
+#include "types.h"
+#include "grid.h"
+
+
+/* Whether a tile blocks sight (and light) */
+bool is_opaque(Tile);
+
+/* Fill `out` (of the same size) with which tiles of the map block sight */
+void opacity_from_tiles(const TileGrid &, BitGrid &out);
+
+/* Refresh the opacity of a single cell after its tile was changed */
+void update_opacity(const TileGrid &, BitGrid &out, int x, int y);
+
+
+
+/*
+    Field of view from a single viewer, using symmetric
+    shadowcasting over a map of opaque cells.
+
+    Each of the eight octants around the viewer is cast and
+    stored separately, so that when one cell changes (such as a
+    door opening) only the octants containing it are cast again.
+    The results are kept as packed bitsets the size of the map:
+    what is visible right now, and everything ever seen.
+*/
+class Fov {
+public:
+
+    Fov(uint16_t width, uint16_t height, uint8_t radius);
+
+    /* Cast everything from scratch with the viewer at (x, y) */
+    void compute(const BitGrid &opaque, int16_t x, int16_t y);
+
+    /* The viewer moved to (x, y) */
+    void move(const BitGrid &opaque, int16_t x, int16_t y);
+
+    /* The opacity of the cell (x, y) changed */
+    void changed(const BitGrid &opaque, int16_t x, int16_t y);
+
+    /* Forget everything remembered, e.g. on a new floor */
+    void forget();
+
+    const BitGrid &visible()    const;
+    const BitGrid &remembered() const;
+
+    Pair<int16_t> origin() const;
+    uint8_t       radius() const;
+
+private:
+
+    void cast(const BitGrid &opaque, uint8_t octant);
+
+    void unpublish();
+    void publish();
+
+    int16_t ox, oy;
+    uint8_t _radius;
+
+    BitGrid _visible;
+    BitGrid _remembered;
+
+    // Results around the viewer, in a (2r + 1) square window
+    // centered on them: one per octant, and their union.
+    BitGrid octants[8];
+    BitGrid window;
+
+    // The corner of the window last copied into `_visible`
+    int16_t wx, wy;
+
+};
@@ -0,0 +1,408 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "style.h"
+#include "theme.h"
+#include "atlas.h"
+#include "software.h"
+#include "text.h"
+#include "ui.h"
+#include "messages.h"
+#include "light.h"
+
+
+/*
+    Golden image tests for the renderer.
+
+    Each scene is drawn by the software backend at a few fixed
+    ticks, from a clock which only moves when told to, so every
+    run draws exactly the same pixels on every machine. Each frame
+    is compared with `golden/<scene>_<ticks>.bmp`, and then drawn
+    over and over again to time it. The timings are appended to
+    `golden/history.csv`, to keep track of them from run to run.
+
+    Given `--update`, every frame is saved as its golden image
+    instead. Otherwise a frame which differs, or which has no
+    golden image of the right size to compare with, fails, and
+    is saved next to its golden image as
+    `<scene>_<ticks>.actual.bmp`, to see what went wrong.
+*/
+
+
+static constexpr const char *GOLDEN_DIR     = "./golden/";
+static constexpr const char *GOLDEN_HISTORY = "./golden/history.csv";
+
+// Channels closer than this to the golden image count as the same
+static constexpr int GOLDEN_CHANNEL_TOLERANCE = 2;
+
+// The fraction of pixels which may differ before a frame fails
+static constexpr double GOLDEN_PIXEL_TOLERANCE = 0.001;
+
+// The number of times each frame is drawn over to time it
+static constexpr size_t GOLDEN_RUNS = 200;
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+
+/* The clock every scene is drawn by, which stands still */
+static uint32_t golden_ticks = 0;
+
+static uint32_t golden_tick_source() { return golden_ticks; }
+
+
+
+/* Scenes */
+
+
+struct Scene {
+    const char           *name;
+    uint16_t              cols, rows; // in tiles
+    std::vector<uint32_t> ticks;      // to draw the scene at
+    std::function<bool()> draw;
+};
+
+
+static constexpr uint16_t STYLES_WIDE = 27;
+static constexpr uint16_t STYLES_HIGH = 5;
+
+/* Each of the eight styles composed in the game, over a few tiles, lit by two fixed torches */
+static bool draw_styles() {
+
+    static Style darken(color_from_palette(PaletteColor::BG_1));
+    static Style hoverw(offset_hover_wave());
+    static Style rainbo(color_rgb_sin());
+
+    static const Pair<int16_t> origin(0, 0);
+    static LightMap lights(STYLES_WIDE, STYLES_HIGH, ColorRGB(0x60, 0x60, 0x60));
+    static Style    torchlit(color_from_light(lights, origin));
+
+    static bool lit = false;
+    if (!lit) {
+        lights.add(Light{ 3,  1, 6, ColorRGB(0xFF, 0xA0, 0x40) });
+        lights.add(Light{ 22, 3, 5, ColorRGB(0x40, 0x80, 0xFF) });
+        lights.update(BitGrid(STYLES_WIDE, STYLES_HIGH));
+        lit = true;
+    }
+
+    static Style style_0{ style_default().compose(torchlit) };
+    static Style style_1{ style_0.compose(rainbo) };
+    static Style style_2{ style_0.compose(darken) };
+    static Style style_3{ style_1.compose(darken) };
+    static Style style_4{ style_0.compose(hoverw) };
+    static Style style_5{ style_1.compose(hoverw) };
+    static Style style_6{ style_2.compose(hoverw) };
+    static Style style_7{ style_3.compose(hoverw) };
+
+    static const Style *styles[2][4] = { { &style_0, &style_2, &style_1, &style_3 },
+                                         { &style_4, &style_6, &style_5, &style_7 } };
+
+    static const Tile sample[2][6] = {
+        { Tile::ALPHANUM_A,  Tile::ALPHANUM_B_BOLD, Tile::ALPHANUM_1,  Tile::PUNCT_PLUS,  Tile::PLAIN_FILL,       Tile::MENU_CURSOR_SELECTED },
+        { Tile::BORDER_NSWE, Tile::BORDER_SE_BOLD,  Tile::BORDER_ROUND_NW, Tile::BORDER_WE, Tile::BORDER_ROUND_NS_BOLD, Tile::PUNCT_MONEY_BOLD },
+    };
+
+    // in blocks of 6 by 2 tiles, with a gap between them
+    for (uint8_t i = 0; i < 2; i++)
+    for (uint8_t j = 0; j < 4; j++)
+    for (uint8_t y = 0; y < 2; y++)
+    for (uint8_t x = 0; x < 6; x++) {
+        const Pair<int8_t> pos = std::make_pair(j * 7 + x, i * 3 + y);
+        if (!draw_tile(sample[y][x], pos, *styles[i][j])) return false;
+    }
+
+    return true;
+}
+
+
+/* Every character `draw_string` knows, multi-character tokens and UTF-8 included */
+static bool draw_characters() {
+    return draw_string(
+        "abcdefghijklmnopqrstuvwxyz\n"
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ\n"
+        "0123456789\n"
+        " .,`'!?:()+-*<>/$\n"
+        "!!! !? ... $$ // **\n"
+        "\u201C\u201D \u2026 \u203C \u2049 \u00F7 \u2716 \u00D7 \u25B8\u25B9 \u2588 \u00E9 \xFF\n"
+        "\u256D\u2500\u252C\u256E \u250F\u2501\u2533\u2513",
+        std::make_pair(0, 0),
+        style_from_palette(PaletteColor::FG_1)
+    );
+}
+
+
+/* Text in every style markup can give it, switching back and forth */
+static bool draw_markup() {
+    static const StyledRun run = parse_markup(
+        "plain {fg2}second {bg2}dark {/}plain\n"
+        "{rainbow}rainbow {wave}waving {fg1}first{/}\n"
+        "{wave}all{/} {fg2}over {wave}again"
+    );
+    return draw_styled(run, std::make_pair(0, 1));
+}
+
+
+/* Text wrapped in boxes, aligned each way, and cut short where it doesn't fit */
+static bool draw_boxes() {
+
+    const Style &fg1 = style_from_palette(PaletteColor::FG_1);
+    const Style &fg2 = style_from_palette(PaletteColor::FG_2);
+
+    return draw_text("the quick brown fox jumps over the lazy dog", std::make_pair(0, 0),  std::make_pair(14, 4), fg1)
+        && draw_text("centred\nunder a\nheading",                  std::make_pair(15, 0), std::make_pair(14, 4), fg2, TextAlign::CENTER)
+        && draw_text("gold: 42$$\nhp: 7/10\n",                      std::make_pair(0, 5),  std::make_pair(14, 4), fg1, TextAlign::RIGHT)
+        && draw_text("far too much text for a box this small to hold", std::make_pair(15, 5), std::make_pair(14, 2), fg2);
+}
+
+
+/* A message log, repeats counted and long messages wrapped, as it is and scrolled back */
+static bool draw_messages() {
+    static MessageLog *log = nullptr;
+
+    if (log == nullptr) {
+        log = new MessageLog(8);
+        log->push("You enter the tower.");
+        log->push("The rat bites you!", PaletteColor::FG_2);
+        log->push("The rat bites you!", PaletteColor::FG_2);
+        log->push("The rat bites you!", PaletteColor::FG_2);
+        log->push("You hit the rat with your sword, and it flees.");
+        log->push("Welcome\nback.");
+    }
+
+    return log->draw(std::make_pair(0, 0),  std::make_pair(14, 7))
+        && log->draw(std::make_pair(15, 0), std::make_pair(14, 5), 1);
+}
+
+
+/* A shop, as a menu and a few labels in panels */
+static bool draw_ui() {
+    static UILayer *layer = nullptr;
+
+    if (layer == nullptr) {
+        Panel *shop = new Panel(Tile::BORDER_ROUND_NONE, PaletteColor::FG_1, "Shop");
+        shop->add<Label>("Spend your gold wisely, traveller.", PaletteColor::FG_2, 18);
+
+        Panel &wares = shop->add<Panel>(Tile::BORDER_NONE, PaletteColor::BG_2);
+        Menu  &menu  = wares.add<Menu>(std::vector<std::string>{ "sword   30$", "shield  25$", "potion  5$" });
+        menu.move(-1);
+
+        shop->add<Label>("gold: 42$$", PaletteColor::FG_1, 18, TextAlign::RIGHT);
+
+        layer = new UILayer(std::move(shop), std::make_pair(0, 0));
+    }
+
+    return layer->draw();
+}
+
+
+static constexpr uint16_t TILES_WIDE = 16;
+
+/* Every tile, in order, as many to a row as there are in a border family */
+static bool draw_tiles() {
+    for (uint16_t t = 0; t < static_cast<uint16_t>(Tile::IDS_COUNT); t++) {
+        const Pair<int8_t> pos = std::make_pair(t % TILES_WIDE, t / TILES_WIDE);
+        if (!draw_tile(Tile(t), pos, style_default())) return false;
+    }
+    return true;
+}
+
+
+static const Scene SCENES[] = {
+    { "styles", STYLES_WIDE, STYLES_HIGH, { 0, 400, 1300 }, draw_styles },
+    { "text",   26, 7,  { 0 },            draw_characters },
+    { "markup", 28, 5,  { 0, 400 },       draw_markup },
+    { "boxes",  29, 9,  { 0 },            draw_boxes  },
+    { "messages", 29, 7, { 0 },           draw_messages },
+    { "ui",     20, 8,  { 0 },            draw_ui     },
+    { "tiles",  TILES_WIDE, (static_cast<uint16_t>(Tile::IDS_COUNT) + TILES_WIDE - 1) / TILES_WIDE,
+                        { 0 },            draw_tiles  },
+};
+
+
+
+/* Comparing frames */
+
+
+/* Load a BMP file as ARGB8888 pixels, returning false if there is none or it is the wrong size */
+static bool load_golden(const std::string &path, uint16_t width, uint16_t height, std::vector<uint32_t> &out) {
+
+    SDL_Surface *loaded = SDL_LoadBMP(path.c_str());
+    if (loaded == nullptr) return false;
+
+    SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(loaded);
+
+    if (surface == nullptr) {
+        fprintf(stderr, "SDL_ConvertSurfaceFormat Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    const bool fits = surface->w == width && surface->h == height;
+    if (fits) {
+        out.resize((size_t)width * height);
+        SDL_LockSurface(surface);
+        for (int y = 0; y < height; y++)
+            memcpy(&out[(size_t)y * width], (const uint8_t *)surface->pixels + (size_t)y * surface->pitch, width * 4);
+        SDL_UnlockSurface(surface);
+    } else {
+        fprintf(stderr, "Golden Error: %s is %dx%d, not %ux%u\n", path.c_str(), surface->w, surface->h, width, height);
+    }
+
+    SDL_FreeSurface(surface);
+    return fits;
+}
+
+
+/* The number of pixels which differ by more than the tolerance */
+static size_t count_differences(const uint32_t *a, const uint32_t *b, size_t n) {
+
+    size_t differ = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            const int d = (int)(a[i] >> shift & 0xFF) - (int)(b[i] >> shift & 0xFF);
+            if (d > GOLDEN_CHANNEL_TOLERANCE || d < -GOLDEN_CHANNEL_TOLERANCE) {
+                differ++;
+                break;
+            }
+        }
+    }
+
+    return differ;
+}
+
+
+
+int main(int argc, char **argv) {
+
+    const bool update = argc > 1 && strcmp(argv[1], "--update") == 0;
+
+    // the same assets as the game, loaded straight away; with
+    // no renderer, the tile map keeps its pixels for the backend
+    Theme theme;
+    if (!load_theme(DEFAULT_THEME, theme)) theme = default_theme();
+
+    TileLegend legend;
+    SDL_Surface *atlas = load_atlas(theme, legend);
+    if (atlas == nullptr) return 1;
+
+    render_config.tile_map(new TileMap(atlas, legend));
+    render_config.palette(theme.palette());
+    SDL_FreeSurface(atlas);
+
+    set_tick_source(golden_tick_source);
+
+
+    FILE *existing = fopen(GOLDEN_HISTORY, "r");
+    const bool fresh = existing == nullptr;
+    if (existing) fclose(existing);
+
+    FILE *history = fopen(GOLDEN_HISTORY, "a");
+    if (history == nullptr) {
+        fprintf(stderr, "Golden Error: cannot write %s\n", GOLDEN_HISTORY);
+    } else if (fresh) {
+        fprintf(history, "time,frame,p50_us,p99_us,result\n");
+    }
+
+    printf("%-16s %10s %10s  %s\n", "frame", "p50 (us)", "p99 (us)", "result");
+
+    size_t failures = 0;
+
+    for (const Scene &scene : SCENES) {
+
+        const uint16_t width  = scene.cols * TILE_RENDER_WIDTH;
+        const uint16_t height = scene.rows * TILE_RENDER_HEIGHT;
+
+        SoftwareBackend *backend = new SoftwareBackend(width, height);
+        render_config.backend(std::move(backend));
+
+        for (uint32_t ticks : scene.ticks) {
+
+            const std::string frame = std::string(scene.name) + "_" + std::to_string(ticks);
+            const std::string path  = GOLDEN_DIR + frame + ".bmp";
+
+            golden_ticks = ticks;
+            update_tick_counts();
+            invalidate_rendering_caches();
+
+            if (!backend->clear() || !scene.draw()) {
+                fprintf(stderr, "Golden Error: %s could not be drawn\n", frame.c_str());
+                failures++;
+                continue;
+            }
+
+
+            /* Check the frame against its golden image */
+
+            const char *result;
+            std::vector<uint32_t> golden;
+
+            if (update) {
+                result = "saved";
+                if (!backend->save(path)) {
+                    result = "unsaved";
+                    failures++;
+                }
+            } else if (!load_golden(path, width, height, golden)) {
+                result = "MISSING";
+                failures++;
+                backend->save(GOLDEN_DIR + frame + ".actual.bmp");
+                fprintf(stderr, "Golden Error: %s has no golden image to compare with (see --update)\n", frame.c_str());
+            } else {
+                const size_t differ = count_differences(backend->pixels(), golden.data(), golden.size());
+                if (differ <= GOLDEN_PIXEL_TOLERANCE * golden.size()) {
+                    result = "ok";
+                } else {
+                    result = "FAILED";
+                    failures++;
+                    backend->save(GOLDEN_DIR + frame + ".actual.bmp");
+                    fprintf(stderr, "Golden Error: %s differs in %zu of %zu pixels\n",
+                            frame.c_str(), differ, golden.size());
+                }
+            }
+
+
+            /* Time drawing the frame, caches and all */
+
+            std::vector<double> times;
+            times.reserve(GOLDEN_RUNS);
+
+            for (size_t i = 0; i < GOLDEN_RUNS; i++) {
+                Clock::time_point t = Clock::now();
+                invalidate_rendering_caches();
+                backend->clear();
+                scene.draw();
+                times.push_back(elapsed_us(t));
+            }
+
+            std::sort(times.begin(), times.end());
+            const double p50 = times[times.size() / 2];
+            const double p99 = times[times.size() * 99 / 100];
+
+            printf("%-16s %10.1f %10.1f  %s\n", frame.c_str(), p50, p99, result);
+            if (history) fprintf(history, "%ld,%s,%.1f,%.1f,%s\n", (long)time(nullptr), frame.c_str(), p50, p99, result);
+        }
+    }
+
+    if (history) fclose(history);
+
+    render_config.backend(nullptr);
+    render_config.tile_map(nullptr);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "types.h"
+
+
+
+/*
+    A dense, row-major two dimensional array of values.
+    Used for maps of tiles, and for any per-cell data
+    which needs to be laid over such a map.
+*/
+template <class T>
+class Grid {
+public:
+
+    Grid()
+        : Grid(0, 0) { }
+
+    Grid(uint16_t width, uint16_t height, const T &fill = T())
+        : _width{width}, _height{height}, cells((size_t)width * height, fill) { }
+
+    uint16_t width()  const { return _width;  }
+    uint16_t height() const { return _height; }
+
+    bool in_bounds(int x, int y) const {
+        return x >= 0 && y >= 0 && x < _width && y < _height;
+    }
+
+    T       &at(int x, int y)       { return cells[(size_t)y * _width + x]; }
+    const T &at(int x, int y) const { return cells[(size_t)y * _width + x]; }
+
+    T       *row(int y)       { return &cells[(size_t)y * _width]; }
+    const T *row(int y) const { return &cells[(size_t)y * _width]; }
+
+    T       *data()       { return cells.data(); }
+    const T *data() const { return cells.data(); }
+
+    void fill(const T &value) { std::fill(cells.begin(), cells.end(), value); }
+
+private:
+
+    uint16_t _width, _height;
+
+    std::vector<T> cells;
+
+};
+
+
+/* The most common kind of grid: a map of tiles */
+typedef Grid<Tile> TileGrid;
+
+
+
+/*
+    A grid of single bits, packed 64 to a word
+    with every row starting on a fresh word.
+*/
+class BitGrid {
+public:
+
+    BitGrid()
+        : BitGrid(0, 0) { }
+
+    BitGrid(uint16_t width, uint16_t height)
+        : _width{width}, _height{height}, _stride{(uint16_t)((width + 63) / 64)}
+        , words((size_t)_stride * height, 0) { }
+
+    uint16_t width()  const { return _width;  }
+    uint16_t height() const { return _height; }
+
+    /* The number of words in each row */
+    uint16_t stride() const { return _stride; }
+
+    bool in_bounds(int x, int y) const {
+        return x >= 0 && y >= 0 && x < _width && y < _height;
+    }
+
+    bool get(int x, int y) const {
+        return (words[(size_t)y * _stride + x / 64] >> (x % 64)) & 1;
+    }
+
+    void set(int x, int y) {
+        words[(size_t)y * _stride + x / 64] |= (uint64_t)1 << (x % 64);
+    }
+
+    void reset(int x, int y) {
+        words[(size_t)y * _stride + x / 64] &= ~((uint64_t)1 << (x % 64));
+    }
+
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+
+    uint64_t       *row(int y)       { return &words[(size_t)y * _stride]; }
+    const uint64_t *row(int y) const { return &words[(size_t)y * _stride]; }
+
+    /* Set every bit which is set in `other` (of the same size) */
+    void merge(const BitGrid &other) {
+        for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+    }
+
+private:
+
+    uint16_t _width, _height, _stride;
+
+    std::vector<uint64_t> words;
+
+};
@@ -1,16 +1,31 @@
 
 #include <SDL2/SDL.h>
+#include <stdio.h>
 #include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include "types.h"
 #include "init.h"
 #include "state.h"
 #include "render.h"
 #include "mappings.h"
+#include "assets.h"
+#include "watch.h"
+#include "theme.h"
+#include "terminal.h"
+#include "software.h"
 
 
 
-bool init() {
+bool init(RenderMode mode) {
+
+    const bool headless = mode == RenderMode::TERMINAL;
+
+    // Without a display there is nowhere to put a window,
+    // but SDL is still needed for its events and timers
+    if (headless) SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
 
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO)) {
@@ -25,7 +40,7 @@ bool init() {
         "SDL2 Test",
          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
          SCREEN_WIDTH, SCREEN_HEIGHT,
-         SDL_WINDOW_SHOWN
+         headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN
     );
 
     if (window == nullptr) {
@@ -34,28 +49,36 @@ bool init() {
         return false;
     }
 
-    // initialize main renderer
-    renderer = SDL_CreateRenderer(
-        window,
-        -1,
-        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
-    );
-
-    if (renderer == nullptr) {
-        fprintf(stderr, "SDL_CreateRenderer Error: %s\n", SDL_GetError());
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return false;
+    // the other backends draw without a renderer, so tile maps stay on the CPU
+    switch (mode) {
+
+    case RenderMode::SOFTWARE:
+        render_config.backend(new SoftwareBackend(SCREEN_WIDTH, SCREEN_HEIGHT, window, 60));
+        break;
+
+    case RenderMode::TERMINAL:
+        render_config.backend(new TerminalBackend(stdout, SCREEN_TILES_WIDE, SCREEN_TILES_HIGH));
+        break;
+
+    case RenderMode::SDL:
+
+        // initialize main renderer
+        renderer = SDL_CreateRenderer(
+            window,
+            -1,
+            SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+        );
+
+        if (renderer == nullptr) {
+            fprintf(stderr, "SDL_CreateRenderer Error: %s\n", SDL_GetError());
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            SDL_Quit();
+            return false;
+        }
+        break;
     }
     
-    // init render_config tile map
-    render_config.tile_map(new TileMap(
-        DEFAULT_TEXTURE_BMP,
-        DEFAULT_TILE_SIZE,
-        Mappings::default_texture_map()
-    ));
-
     // init random systems
     time_t t;
     srand((unsigned)time(&t));
@@ -69,6 +92,83 @@ bool init() {
 
 
 
+/* Bake the pack for `theme`, handing the tile map and palette to render_config */
+static void load_pack(AssetLoader &loader, const Theme &theme) {
+    loader.load_pack(
+        DEFAULT_ASSET_PACK,
+        theme,
+        [](TileMap *map) { render_config.tile_map(std::move(map)); },
+        [](Palette *pal) { render_config.palette(std::move(pal)); }
+    );
+}
+
+
+/*
+    Queue up every asset the game starts with.
+*/
+void load_assets(AssetLoader &loader) {
+
+    // the theme file, or the one built in if it is missing or broken
+    Theme theme;
+    if (!load_theme(DEFAULT_THEME, theme)) theme = default_theme();
+
+    load_pack(loader, theme);
+
+}
+
+
+static void watch_theme(FileWatcher &watcher, AssetLoader &loader, const Theme &theme);
+
+
+/* Load the assets again, unless the theme no longer parses */
+static void reload_assets(FileWatcher &watcher, AssetLoader &loader) {
+
+    // a theme saved with a mistake in it is ignored until it is fixed,
+    // so the game keeps the tile map and palette it had
+    Theme theme;
+    if (!load_theme(DEFAULT_THEME, theme)) {
+        fprintf(stderr, "Theme Error: keeping the last theme which loaded\n");
+        return;
+    }
+
+    load_pack(loader, theme);
+
+    // the new theme may use other textures
+    watch_theme(watcher, loader, theme);
+
+}
+
+
+/* Watch the theme file and every texture `theme` uses, and nothing else */
+static void watch_theme(FileWatcher &watcher, AssetLoader &loader, const Theme &theme) {
+
+    // a changed theme or BMP file makes the pack stale, so it is baked again
+    const FileWatcher::OnChange reload = [&watcher, &loader]() { reload_assets(watcher, loader); };
+
+    watcher.clear();
+    watcher.watch(DEFAULT_THEME, reload);
+
+    std::vector<std::string> textures;
+    for (const Theme::Tileset &set : theme.tilesets) {
+        if (std::find(textures.begin(), textures.end(), set.texture) != textures.end()) continue;
+        textures.push_back(set.texture);
+        watcher.watch(set.texture, reload);
+    }
+
+}
+
+
+void watch_assets(FileWatcher &watcher, AssetLoader &loader) {
+
+    Theme theme;
+    if (!load_theme(DEFAULT_THEME, theme)) theme = default_theme();
+
+    watch_theme(watcher, loader, theme);
+
+}
+
+
+
 /*
     Update global variables
 */
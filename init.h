@@ -5,13 +5,41 @@
 
 #include "types.h"
 #include "render.h"
+#include "assets.h"
+#include "watch.h"
+
+
+/* Where, and with what, frames are drawn */
+enum class RenderMode : uint8_t {
+    SDL,      // by the SDL renderer, into the window
+    SOFTWARE, // on the CPU, into the window
+    TERMINAL, // as text on stdout, with no window shown
+};
 
 
 /*
     Make sure the main subsystems necessary to run the
-    program are initialized.
+    program are initialized, and ready to draw with `mode`.
+*/
+bool init(RenderMode mode = RenderMode::SDL);
+
+
+/*
+    Start loading the assets needed to play, such as
+    tile maps, in the background. Nothing should be drawn
+    with them until `loader` has finished.
+*/
+void load_assets(AssetLoader &loader);
+
+
+/*
+    Load the assets again whenever the files they come
+    from change. The reloading itself happens on the
+    worker thread of `loader`, and the new assets replace
+    the old ones when `loader` is next polled, which
+    should be between frames.
 */
-bool init();
+void watch_assets(FileWatcher &watcher, AssetLoader &loader);
 
 
 /*
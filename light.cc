@@ -0,0 +1,280 @@
+
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <cmath>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "types.h"
+#include "grid.h"
+#include "fov.h"
+#include "state.h"
+#include "style.h"
+#include "light.h"
+
+
+// Resolving copies four summed channels straight into each color
+static_assert(sizeof(ColorRGBA) == 4, "ColorRGBA must be four packed bytes");
+
+
+
+/* Implementation of LightMap */
+
+
+constexpr uint8_t LightMap::MAX_RADIUS;
+
+
+LightMap::LightMap(uint16_t width, uint16_t height, ColorRGB ambient)
+    : sums(4 * width, height, 0)
+    , light(width, height, ColorRGBA(ambient.r, ambient.g, ambient.b))
+    , _ambient{ambient}
+    , casters(MAX_RADIUS + 1)
+    , dx0{width}, dy0{height}, dx1{-1}, dy1{-1} { }
+
+
+LightId LightMap::add(const Light &l) {
+    LightId id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    } else {
+        id = (LightId)sources.size();
+        sources.push_back(Source());
+    }
+
+    Source &s = sources[id];
+    s.light = l;
+    s.alive = true;
+    s.x0 = s.y0 = 0;
+    s.w  = s.h  = 0;
+    s.contribution.clear();
+
+    s.dirty = true;
+    return id;
+}
+
+
+void LightMap::remove(LightId id) {
+    Source &s = sources[id];
+    if (!s.alive) return;
+
+    apply(s, false);
+    dirty_area(s.x0, s.y0, s.x0 + s.w - 1, s.y0 + s.h - 1);
+
+    s.contribution.clear();
+    s.alive = false;
+    free_ids.push_back(id);
+}
+
+
+void LightMap::move(LightId id, int16_t x, int16_t y) {
+    Source &s = sources[id];
+    if (s.light.x == x && s.light.y == y) return;
+
+    s.light.x = x;
+    s.light.y = y;
+    s.dirty = true;
+}
+
+
+void LightMap::set(LightId id, const Light &l) {
+    sources[id].light = l;
+    sources[id].dirty = true;
+}
+
+
+void LightMap::ambient(ColorRGB c) {
+    _ambient = c;
+    dirty_area(0, 0, light.width() - 1, light.height() - 1);
+}
+
+
+void LightMap::changed(int16_t x, int16_t y) {
+    // only sources whose light reached (or could reach) the cell care
+    for (Source &s : sources) {
+        if (!s.alive || s.dirty) continue;
+        if (x >= s.x0 && x < s.x0 + s.w && y >= s.y0 && y < s.y0 + s.h) s.dirty = true;
+    }
+}
+
+
+void LightMap::dirty_area(int x0, int y0, int x1, int y1) {
+    if (x1 < x0 || y1 < y0) return;
+
+    dx0 = std::min(dx0, x0);
+    dy0 = std::min(dy0, y0);
+    dx1 = std::max(dx1, x1);
+    dy1 = std::max(dy1, y1);
+}
+
+
+void LightMap::update(const BitGrid &opaque) {
+
+    for (Source &s : sources) {
+        if (!s.alive || !s.dirty) continue;
+
+        apply(s, false);
+        dirty_area(s.x0, s.y0, s.x0 + s.w - 1, s.y0 + s.h - 1);
+
+        cast(s, opaque);
+
+        apply(s, true);
+        dirty_area(s.x0, s.y0, s.x0 + s.w - 1, s.y0 + s.h - 1);
+
+        s.dirty = false;
+    }
+
+    resolve();
+}
+
+
+void LightMap::cast(Source &s, const BitGrid &opaque) {
+
+    const Light  &l = s.light;
+    const int16_t r = std::min(l.radius, MAX_RADIUS);
+
+    s.contribution.clear();
+    s.w = s.h = 0;
+    if (!opaque.in_bounds(l.x, l.y)) return;
+
+    std::unique_ptr<Fov> &caster = casters[r];
+    if (!caster) caster.reset(new Fov(opaque.width(), opaque.height(), r));
+    caster->compute(opaque, l.x, l.y);
+
+    const BitGrid &lit = caster->visible();
+
+    s.x0 = std::max(l.x - r, 0);
+    s.y0 = std::max(l.y - r, 0);
+    s.w  = std::min(l.x + r, opaque.width()  - 1) - s.x0 + 1;
+    s.h  = std::min(l.y + r, opaque.height() - 1) - s.y0 + 1;
+    s.contribution.assign((size_t)s.w * s.h * 4, 0);
+
+    for (int j = 0; j < s.h; j++)
+    for (int i = 0; i < s.w; i++) {
+
+        const int x = s.x0 + i;
+        const int y = s.y0 + j;
+        if (!lit.get(x, y)) continue;
+
+        // linear falloff, reaching nothing just past the radius
+        const float d = std::sqrt((float)((x - l.x) * (x - l.x) + (y - l.y) * (y - l.y)));
+        const int   k = std::max(0, (int)(256 * (1 - d / (r + 1))));
+
+        uint16_t *c = &s.contribution[((size_t)j * s.w + i) * 4];
+        c[0] = (l.color.r * k) >> 8;
+        c[1] = (l.color.g * k) >> 8;
+        c[2] = (l.color.b * k) >> 8;
+    }
+}
+
+
+/* Add (or take away) the contribution of a source to the sums */
+void LightMap::apply(const Source &s, bool adding) {
+
+    const size_t n = (size_t)s.w * 4;
+
+    for (int j = 0; j < s.h; j++) {
+
+        uint16_t       *dst = sums.row(s.y0 + j) + s.x0 * 4;
+        const uint16_t *src = &s.contribution[j * n];
+        size_t i = 0;
+
+#ifdef __SSE2__
+        for (; i + 8 <= n; i += 8) {
+            const __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), adding ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b));
+        }
+#endif
+
+        for (; i < n; i++) dst[i] = adding ? dst[i] + src[i] : dst[i] - src[i];
+    }
+}
+
+
+/* Turn the sums in the dirty area into colors, adding the ambient light */
+void LightMap::resolve() {
+
+    if (dx1 < dx0 || dy1 < dy0) return;
+
+    dx0 = std::max(dx0, 0);
+    dy0 = std::max(dy0, 0);
+    dx1 = std::min(dx1, light.width()  - 1);
+    dy1 = std::min(dy1, light.height() - 1);
+
+    for (int y = dy0; y <= dy1; y++) {
+
+        const uint16_t *src = sums.row(y) + dx0 * 4;
+        uint8_t        *dst = (uint8_t *)(light.row(y) + dx0);
+        const size_t    n   = (size_t)(dx1 - dx0 + 1) * 4;
+        size_t i = 0;
+
+#ifdef __SSE2__
+        const __m128i ambient = _mm_set_epi16(0, _ambient.b, _ambient.g, _ambient.r,
+                                              0, _ambient.b, _ambient.g, _ambient.r);
+        const __m128i max     = _mm_set1_epi16(0xFF);
+        const __m128i opaque  = _mm_set1_epi32(0xFF000000);
+
+        for (; i + 16 <= n; i += 16) {
+            __m128i lo = _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(src + i)),     ambient);
+            __m128i hi = _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(src + i + 8)), ambient);
+
+            // min(v, 255), since packing would read large sums as negative
+            lo = _mm_sub_epi16(lo, _mm_subs_epu16(lo, max));
+            hi = _mm_sub_epi16(hi, _mm_subs_epu16(hi, max));
+
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+        }
+#endif
+
+        const uint8_t amb[4] = { _ambient.r, _ambient.g, _ambient.b, 0 };
+        for (; i < n; i++)
+            dst[i] = (i % 4 == 3) ? 0xFF : (uint8_t)std::min(src[i] + amb[i % 4], 0xFF);
+    }
+
+    dx0 = light.width();
+    dy0 = light.height();
+    dx1 = dy1 = -1;
+}
+
+
+ColorRGBA LightMap::at(int x, int y) const {
+    return light.at(x, y);
+}
+
+
+const Grid<ColorRGBA> &LightMap::resolved() const {
+    return light;
+}
+
+
+
+Color *color_from_light(const LightMap &map, const Pair<int16_t> &origin) {
+
+    class LitColor : public Color {
+
+        const LightMap      &map;
+        const Pair<int16_t> &origin;
+
+    public:
+
+        LitColor(const LightMap &map, const Pair<int16_t> &origin)
+            : Color(CachingType::DYNAMIC_NOCACHE), map(map), origin(origin) { }
+
+        void invalidate() { }
+
+        const ColorRGBA value() {
+            const int x = origin.first  + render_config.info.pos.first;
+            const int y = origin.second + render_config.info.pos.second;
+
+            if (!map.resolved().in_bounds(x, y)) return ColorRGBA(0xFF, 0xFF, 0xFF);
+            return map.at(x, y);
+        }
+
+    };
+
+    return new LitColor(map, origin);
+}
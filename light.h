@@ -0,0 +1,108 @@
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "types.h"
+#include "grid.h"
+#include "fov.h"
+#include "style.h"
+
+
+/* A source of colored light, such as a torch */
+struct Light {
+    int16_t  x, y;
+    uint8_t  radius;
+    ColorRGB color;
+};
+
+typedef uint16_t LightId;
+
+
+
+/*
+    The colored light falling on every cell of a map.
+
+    Each source casts light with shadowcasting over the same
+    opaque cells used for field of view, and keeps what it
+    contributed to the square around it. Contributions are
+    summed per channel in 16 bits, so a source is removed by
+    subtracting exactly what it added; only sources which
+    moved, changed, or had a wall change near them are cast
+    again, and only the area they cover is updated.
+*/
+class LightMap {
+public:
+
+    static constexpr uint8_t MAX_RADIUS = 16u;
+
+    LightMap(uint16_t width, uint16_t height, ColorRGB ambient = ColorRGB());
+
+    LightId add(const Light &);
+    void    remove(LightId);
+
+    void move(LightId, int16_t x, int16_t y);
+    void set(LightId, const Light &);
+
+    /* The light cast where nothing else shines */
+    void ambient(ColorRGB);
+
+    /* The opacity of the cell (x, y) changed */
+    void changed(int16_t x, int16_t y);
+
+    /* Cast every light which needs it, and bring the results up to date */
+    void update(const BitGrid &opaque);
+
+    /* The light on (x, y), as of the last update */
+    ColorRGBA at(int x, int y) const;
+
+    const Grid<ColorRGBA> &resolved() const;
+
+private:
+
+    struct Source {
+        Light    light;
+        bool     alive, dirty;
+
+        // the contribution last added to `sums`, over the
+        // (clipped) square from (x0, y0) of w by h cells
+        int16_t  x0, y0;
+        uint16_t w, h;
+        std::vector<uint16_t> contribution;
+    };
+
+    void dirty_area(int x0, int y0, int x1, int y1);
+
+    void cast(Source &, const BitGrid &opaque);
+    void apply(const Source &, bool adding);
+    void resolve();
+
+    // four channels per cell (the fourth unused) of summed light
+    Grid<uint16_t>  sums;
+    Grid<ColorRGBA> light;
+
+    ColorRGB _ambient;
+
+    std::vector<Source>  sources;
+    std::vector<LightId> free_ids;
+
+    // shadowcasters for each radius, made as they are needed
+    std::vector<std::unique_ptr<Fov>> casters;
+
+    // the area needing to be resolved again
+    int dx0, dy0, dx1, dy1;
+
+};
+
+
+
+/*
+    A color which is the light on whichever map cell is being
+    drawn, found from the screen position being drawn and the
+    map cell at the top left of the screen. `origin` is read on
+    every draw, so it can follow the view as it scrolls.
+    Composing a style with it multiplies the light into the
+    style's own color.
+*/
+Color *color_from_light(const LightMap &, const Pair<int16_t> &origin);
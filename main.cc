@@ -1,20 +1,118 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <cmath>
+#include <algorithm>
+#include <vector>
+#include <memory>
 
 #include "types.h"
 #include "state.h"
 #include "render.h"
 #include "init.h"
 #include "style.h"
+#include "entity.h"
+#include "scheduler.h"
+#include "spatial.h"
+#include "light.h"
+#include "particles.h"
+#include "assets.h"
+#include "watch.h"
+#include "tint.h"
+#include "capture.h"
 
 
-int main() {
+/*
+    Everyone whose turn comes up next takes it; for now, a random
+    step, throwing sparks if they bump into someone else.
+*/
+static void take_turns(EntityStore &entities, SpatialIndex &index, TurnScheduler &turns,
+                       ParticlePool &effects, std::vector<Entity> &acting) {
 
-    if (!init())
+    if (!turns.next(acting)) return;
+
+    for (Entity e : acting) {
+        Pair<int16_t> &pos = entities.positions.get(e);
+        const Pair<int16_t> to = std::make_pair(pos.first + rand() % 3 - 1, pos.second + rand() % 3 - 1);
+
+        if (index.occupied(to.first, to.second) && index.top(to.first, to.second) != e) {
+            effects.burst(Tile::PUNCT_MULTSMALL, to.first + 0.25f, to.second + 0.25f, 8, 3.0f, 0.4f, style_rgb_sin());
+            effects.number(1 + rand() % 20, to.first, to.second - 0.5f, style_default());
+        } else if (index.in_bounds(to.first, to.second)) {
+            index.move(e, to);
+            pos = to;
+        }
+
+        turns.spend(e, TURN_ENERGY);
+    }
+}
+
+
+/* How the loading screen ended */
+enum class Loading {
+    READY,  // every asset is loaded
+    QUIT,   // the game was closed first
+    FAILED, // an asset failed to load
+};
+
+
+/* Show a loading screen until every asset is ready */
+static Loading loading_screen(AssetLoader &assets) {
+
+    load_assets(assets);
+
+    SDL_Event e;
+
+    while (!assets.finished()) {
+
+        update_globals();
+
+        while (SDL_PollEvent(&e))
+            if (e.type == SDL_QUIT) return Loading::QUIT;
+
+        if (!assets.poll()) return Loading::FAILED;
+
+        begin_frame();
+        draw_progress(assets);
+        end_frame();
+    }
+
+    return Loading::READY;
+}
+
+
+int main(int argc, char **argv) {
+
+    // `--terminal` draws to the terminal, for running with no display,
+    // `--software` draws on the CPU, without the SDL renderer,
+    // and `--capture PATH` records every frame of the game to PATH
+    RenderMode  mode = RenderMode::SDL;
+    const char *capture_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--terminal") == 0) mode = RenderMode::TERMINAL;
+        if (strcmp(argv[i], "--software") == 0) mode = RenderMode::SOFTWARE;
+        if (strcmp(argv[i], "--capture")  == 0 && i + 1 < argc) capture_path = argv[++i];
+    }
+
+    if (!init(mode))
         return -1;
 
+    AssetLoader assets;
+
+    const Loading loaded = loading_screen(assets);
+    if (loaded != Loading::READY) {
+        render_config.backend(nullptr);
+        render_config.tile_map(nullptr);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return loaded == Loading::QUIT ? 0 : -1;
+    }
+
+    // tiles in palette colors are tinted once, up to a few megabytes of them
+    if (renderer != nullptr) render_config.tint_cache(new TintCache(4u << 20));
+
 /*    {{{    */
         
     Tile display_tiles[SCREEN_TILES_WIDE][SCREEN_TILES_HIGH];
@@ -28,7 +126,13 @@ int main() {
     Style hoverw(offset_hover_wave());
     Style rainbo(color_rgb_sin());
 
-    Style style_0{ style_default() };
+    // Everything on screen is lit by torches, over a dim ambient light
+    const Pair<int16_t> view_origin(0, 0);
+    BitGrid  open(SCREEN_TILES_WIDE, SCREEN_TILES_HIGH);
+    LightMap lights(SCREEN_TILES_WIDE, SCREEN_TILES_HIGH, ColorRGB(0x60, 0x60, 0x60));
+    Style    torchlit(color_from_light(lights, view_origin));
+
+    Style style_0{ style_default().compose(torchlit) };
     Style style_1{ style_0.compose(rainbo) };
 
     Style style_2{ style_0.compose(darken) };
@@ -43,16 +147,74 @@ int main() {
     Style styles[2][4] = { { style_0, style_2, style_1, style_3 }, 
                            { style_4, style_6, style_5, style_7 } };
 
+
+    // A few wanderers, acting as often as their speed allows
+    EntityStore   entities;
+    SpatialIndex  index(SCREEN_TILES_WIDE, SCREEN_TILES_HIGH);
+    TurnScheduler turns;
+
+    StyleTable entity_styles;
+    const StyleId rainbow = entity_styles.add(style_1);
+
+    for (uint8_t i = 0; i < 16; i++) {
+        const Pair<int16_t> pos = std::make_pair(int16_t(rand() % SCREEN_TILES_WIDE), int16_t(rand() % SCREEN_TILES_HIGH));
+        if (index.occupied(pos.first, pos.second)) continue;
+
+        Entity e = entities.create();
+        entities.positions.add(e, pos);
+        entities.glyphs.add(e, Tile(uint8_t(Tile::ALPHANUM_A_BOLD) + i));
+        if (i % 2) entities.styles.add(e, rainbow);
+
+        index.insert(e, pos);
+        turns.add(e, 5 + rand() % 30);
+    }
+
+    std::vector<Entity> acting;
+
+    ParticlePool effects(4096);
+    TileBatch    effect_tiles;
+
+    // which wanderers carry which torches
+    std::vector<Pair<Entity, LightId>> torches;
+    entities.each([&](Entity e, const Pair<int16_t> &p) {
+        const ColorRGB flame(0xFF, 0x80 + rand() % 0x60, 0x20 + rand() % 0x40);
+        torches.push_back(std::make_pair(e, lights.add(Light{ p.first, p.second, 6, flame })));
+    }, entities.positions);
+
 /*    }}}    */
 
 
+    // Edited assets are reloaded in the background, and swapped in between frames
+    FileWatcher watcher;
+    watch_assets(watcher, assets);
+
+    // Frames are recorded on another thread, so the disk never holds up drawing
+    std::unique_ptr<FrameCapture> capture;
+    if (capture_path && mode == RenderMode::TERMINAL) {
+        fprintf(stderr, "Capture Error: there are no pixels to capture in the terminal\n");
+    } else if (capture_path) {
+        capture.reset(new FrameCapture(capture_path, SCREEN_WIDTH, SCREEN_HEIGHT));
+    }
+
     SDL_Event e;
 
     // Main loop
     for (;;) {
 
+        watcher.poll();
+        assets.poll();
+
         update_globals();
 
+        take_turns(entities, index, turns, effects, acting);
+        effects.update(get_ticks_delta() / 1000.0f);
+
+        for (const Pair<Entity, LightId> &torch : torches) {
+            const Pair<int16_t> &p = entities.positions.get(torch.first);
+            lights.move(torch.second, p.first, p.second);
+        }
+        lights.update(open);
+
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
             case SDL_QUIT:
@@ -63,7 +225,7 @@ int main() {
             }
         }
 
-        SDL_RenderClear(renderer);
+        begin_frame();
         
 /*    {{{    */
         
@@ -82,6 +244,12 @@ int main() {
             }
         }
 
+        draw_entities(entities, index, entity_styles, view_origin, style_default());
+
+        effect_tiles.clear();
+        effects.draw(effect_tiles, view_origin);
+        draw_tile_batch(effect_tiles);
+
         for (int i = 0; i < 5; i++) {
             uint16_t x = rand() % SCREEN_TILES_WIDE;
             uint16_t y = rand() % SCREEN_TILES_HIGH;
@@ -90,12 +258,24 @@ int main() {
 
 /*    }}}    */
 
-        SDL_RenderPresent(renderer);
+        if (capture) capture->grab();
+
+        end_frame();
 
     }
 
     after_main_loop:
 
+    // the last frames are written out before the renderer they came from goes
+    capture.reset();
+
+    // the atlas and tinted tiles have to go before the renderer they belong to
+    render_config.tint_cache(nullptr);
+    render_config.tile_map(nullptr);
+
+    // which puts the terminal back the way it was
+    render_config.backend(nullptr);
+
     SDL_DestroyWindow(window);
     
     SDL_Quit();
@@ -182,4 +182,25 @@ Palette *Mappings::default_palette() {
     };
     
     return &palette;
-}
\ No newline at end of file
+}
+
+
+
+TileLegend legend_from_mapping(const Pair<uint8_t> tile_size, const TextureMapping *tex_map) {
+
+    TileLegend legend;
+    legend.fill(SDL_Rect{ 0, 0, 0, 0 });
+
+    for (auto const& it : *tex_map) {
+        Tile t = it.first;
+        Pair<uint8_t> p = it.second;
+        legend[static_cast<size_t>(t)] = SDL_Rect{
+            p.first  * tile_size.first,
+            p.second * tile_size.second,
+            tile_size.first,
+            tile_size.second
+        };
+    }
+
+    return legend;
+}
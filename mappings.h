@@ -11,4 +11,8 @@ namespace Mappings {
 
     Palette *default_palette();
 
-}
\ No newline at end of file
+}
+
+
+/* Work out the region of each tile in `mapping`, for tiles of `tile_size` pixels */
+TileLegend legend_from_mapping(const Pair<uint8_t> tile_size, const TextureMapping *);
@@ -0,0 +1,124 @@
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "style.h"
+#include "render.h"
+#include "text.h"
+#include "messages.h"
+
+
+
+/* Implementation of MessageLog */
+
+
+MessageLog::MessageLog(size_t capacity)
+    : entries(capacity ? capacity : 1), head{0}, _size{0}, _total{0} { }
+
+
+size_t   MessageLog::size()  const { return _size;  }
+uint64_t MessageLog::total() const { return _total; }
+
+
+void MessageLog::clear() {
+    head  = 0;
+    _size = 0;
+}
+
+
+const MessageLog::Entry &MessageLog::newest(size_t back) const {
+    return entries[(head + entries.size() - 1 - back) % entries.size()];
+}
+
+
+void MessageLog::push(const std::string &text, PaletteColor color) {
+
+    _total++;
+
+    if (_size > 0) {
+        Entry &last = entries[(head + entries.size() - 1) % entries.size()];
+        if (last.color == color && last.text == text) {
+            if (last.count < UINT16_MAX) last.count++;
+            return;
+        }
+    }
+
+    // the oldest entry is written over, and its buffers with it
+    Entry &entry = entries[head];
+    head = (head + 1) % entries.size();
+    if (_size < entries.size()) _size++;
+
+    entry.text  = text;
+    entry.color = color;
+    entry.count = 1;
+    entry.tiles.clear();
+    entry.wrapped_width = 0; // never a width drawn at
+
+    for (size_t i = 0; i < text.size() && entry.tiles.size() < MAX_LENGTH;) {
+        const TextToken token = read_token(text, i);
+        i += token.length;
+
+        // a log line is one line, however it was written
+        entry.tiles.push_back(token.newline ? Tile::PUNCT_SPACE : token.tile);
+    }
+}
+
+
+const std::vector<std::vector<Tile>> &MessageLog::wrapped(const Entry &entry, uint8_t width) {
+
+    if (entry.wrapped_width == width && entry.wrapped_count == entry.count) return entry.lines;
+
+    // the count goes on the end, as " x3", wrapping like any other word
+    std::vector<Tile> tiles(entry.tiles);
+    if (entry.count > 1) {
+        const std::string suffix = " x" + std::to_string(entry.count);
+        for (size_t i = 0; i < suffix.size();) {
+            const TextToken token = read_token(suffix, i);
+            i += token.length;
+            tiles.push_back(token.tile);
+        }
+    }
+
+    entry.lines.clear();
+    wrap_tiles(tiles, width, entry.lines);
+
+    entry.wrapped_width = width;
+    entry.wrapped_count = entry.count;
+
+    return entry.lines;
+}
+
+
+bool MessageLog::draw(Pair<int8_t> pos, Pair<uint8_t> size, size_t scroll) const {
+
+    const uint8_t width = size.first;
+    if (width == 0) return true;
+
+    // the rows left to fill, from the bottom up
+    int row = size.second;
+
+    for (size_t back = scroll; back < _size && row > 0; back++) {
+
+        const Entry &entry = newest(back);
+        const std::vector<std::vector<Tile>> &lines = wrapped(entry, width);
+
+        row -= (int)lines.size();
+
+        const Style style = style_from_palette(entry.color);
+
+        for (size_t y = 0; y < lines.size(); y++) {
+            if (row + (int)y < 0) continue; // above the top of the pane
+
+            for (size_t x = 0; x < lines[y].size(); x++) {
+                const Tile t = lines[y][x];
+                if (t == Tile::PUNCT_SPACE) continue;
+
+                const Pair<int8_t> at = std::make_pair(pos.first + x, pos.second + row + y);
+                if (!draw_tile(t, at, style)) return false;
+            }
+        }
+    }
+
+    return true;
+}
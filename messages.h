@@ -0,0 +1,76 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "style.h"
+
+
+/*
+    The log of messages the game has to tell, like what hit what
+    in a fight, of which only the most recent few are kept.
+
+    Messages are read into tiles as they arrive, into a ring of
+    entries which are written over once it wraps around, so the
+    memory used never grows past what the first lap allocated.
+    A message the same as the one before it only counts it
+    again, and is shown once, as "message x3".
+
+    Drawing starts from the newest message and stops once the
+    pane is full, so it costs the same however long the log,
+    and a message is only wrapped again when its count or the
+    width of the pane has changed.
+*/
+class MessageLog {
+public:
+
+    // The tiles kept of any one message, the rest being cut off
+    static constexpr size_t MAX_LENGTH = 160u;
+
+    MessageLog(size_t capacity);
+
+    void push(const std::string &, PaletteColor = PaletteColor::FG_1);
+    void clear();
+
+    /* The number of messages kept, and ever pushed (repeats included) */
+    size_t   size()  const;
+    uint64_t total() const;
+
+    /*
+        Draw the newest messages in the box at `pos`, `size` tiles
+        across and down, the newest at the bottom. Messages longer
+        than the box is wide are wrapped between words, as
+        `layout_text` does, and the oldest one shown may be cut
+        off at the top. `scroll` skips that many of the newest
+        messages, to look back.
+    */
+    bool draw(Pair<int8_t> pos, Pair<uint8_t> size, size_t scroll = 0) const;
+
+private:
+
+    struct Entry {
+        std::string       text;  // as pushed, to spot repeats
+        std::vector<Tile> tiles;
+        PaletteColor      color;
+        uint16_t          count; // the times it was pushed in a row
+
+        // the tiles and count as last wrapped, and how wide
+        mutable std::vector<std::vector<Tile>> lines;
+        mutable uint8_t                        wrapped_width;
+        mutable uint16_t                       wrapped_count;
+    };
+
+    const Entry &newest(size_t back) const;
+
+    /* The lines of an entry wrapped `width` across, wrapped again only if it has changed */
+    static const std::vector<std::vector<Tile>> &wrapped(const Entry &, uint8_t width);
+
+    std::vector<Entry> entries;
+
+    size_t   head;  // where the next message goes
+    size_t   _size;
+    uint64_t _total;
+
+};
@@ -0,0 +1,417 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <stdlib.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "types.h"
+#include "render.h"
+#include "theme.h"
+#include "atlas.h"
+#include "pack.h"
+
+
+
+/*
+    Layout constants. All integers are little endian, except
+    for the pixels, which are ARGB8888 words in the byte order
+    of the machine which baked them (the byte order is part
+    of the content hash, so a pack from elsewhere is rebuilt).
+
+    header:  "IVTP" u16 version, u16 tile count, u16 color count,
+             u16 reserved, u64 content hash, u16 width, u16 height,
+             u32 pitch, u32 pixel offset
+    legend:  u16 x, u16 y, u16 w, u16 h             (per tile id)
+    palette: u8 r, u8 g, u8 b, u8 a                 (per palette color)
+    pixels:  pitch * height bytes, from the first 16 byte
+             boundary after the palette
+*/
+
+static constexpr char     PACK_MAGIC[4]      = { 'I', 'V', 'T', 'P' };
+static constexpr uint16_t PACK_VERSION       = 2u;
+static constexpr size_t   PACK_HEADER        = 32u;
+static constexpr size_t   PACK_LEGEND_ENTRY  = 8u;
+static constexpr size_t   PACK_PALETTE_ENTRY = 4u;
+
+static constexpr size_t TILE_COUNT  = static_cast<size_t>(Tile::IDS_COUNT);
+static constexpr size_t COLOR_COUNT = static_cast<size_t>(PaletteColor::COLOR_COUNT);
+
+static constexpr size_t PACK_LEGEND  = PACK_HEADER;
+static constexpr size_t PACK_PALETTE = PACK_LEGEND + TILE_COUNT * PACK_LEGEND_ENTRY;
+static constexpr size_t PACK_PIXELS  = (PACK_PALETTE + COLOR_COUNT * PACK_PALETTE_ENTRY + 15) & ~(size_t)15;
+
+
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p,     v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p,     v & 0xFFFFFFFF);
+    put_u32(p + 4, v >> 32);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+
+
+/*
+    Hashing. FNV-1a is plenty to notice an edited file,
+    and the tile map is small enough for its speed not to matter.
+*/
+
+static uint64_t fnv1a(uint64_t h, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+
+/* The legend and palette as they are stored in a pack */
+static void put_tables(uint8_t *p, const TileLegend &legend, const PaletteTable &palette) {
+
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+        uint8_t *entry = p + t * PACK_LEGEND_ENTRY;
+        put_u16(entry,     legend[t].x);
+        put_u16(entry + 2, legend[t].y);
+        put_u16(entry + 4, legend[t].w);
+        put_u16(entry + 6, legend[t].h);
+    }
+
+    p += TILE_COUNT * PACK_LEGEND_ENTRY;
+
+    for (size_t c = 0; c < COLOR_COUNT; c++) {
+        const ColorRGBA &color = palette[c];
+
+        uint8_t *entry = p + c * PACK_PALETTE_ENTRY;
+        entry[0] = color.r;
+        entry[1] = color.g;
+        entry[2] = color.b;
+        entry[3] = color.a;
+    }
+}
+
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &out) {
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return false;
+
+    fseek(f, 0, SEEK_END);
+    const long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    out.resize(length > 0 ? length : 0);
+    const bool ok = length > 0 && fread(&out[0], 1, out.size(), f) == out.size();
+
+    fclose(f);
+    return ok;
+}
+
+
+
+uint64_t pack_source_hash(const Theme &theme) {
+
+    uint8_t format[4];
+    put_u16(format,     PACK_VERSION);
+    put_u16(format + 2, SDL_BYTEORDER);
+
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = fnv1a(h, format, sizeof format);
+
+    // the legend and palette exactly as a pack stores them,
+    // with the tileset of each tile alongside
+    std::vector<uint8_t> tables(PACK_PIXELS - PACK_LEGEND);
+    put_tables(&tables[0], theme.legend, theme.colors);
+    h = fnv1a(h, &tables[0], tables.size());
+    h = fnv1a(h, theme.source.data(), theme.source.size());
+
+    std::vector<uint8_t> bmp;
+    for (const Theme::Tileset &set : theme.tilesets) {
+        if (!read_file(set.texture, bmp)) return 0;
+        h = fnv1a(h, bmp.data(), bmp.size());
+    }
+
+    // zero is kept to mean "no hash"
+    return h ? h : 1;
+}
+
+
+
+/* Baking */
+
+
+bool bake_pack(const Theme &theme, const std::string &path) {
+
+    const uint64_t hash = pack_source_hash(theme);
+    if (hash == 0) {
+        fprintf(stderr, "bake_pack Error: could not read the textures of the theme\n");
+        return false;
+    }
+
+    TileLegend legend;
+    SDL_Surface *surface = load_atlas(theme, legend);
+    if (surface == nullptr) return false;
+
+    if (surface->w > UINT16_MAX || surface->h > UINT16_MAX) {
+        fprintf(stderr, "bake_pack Error: the atlas is too large to pack\n");
+        SDL_FreeSurface(surface);
+        return false;
+    }
+
+    const size_t pixels = (size_t)surface->pitch * surface->h;
+
+    std::vector<uint8_t> buffer(PACK_PIXELS + pixels, 0);
+
+    memcpy(&buffer[0], PACK_MAGIC, 4);
+    put_u16(&buffer[4],  PACK_VERSION);
+    put_u16(&buffer[6],  TILE_COUNT);
+    put_u16(&buffer[8],  COLOR_COUNT);
+    put_u16(&buffer[10], 0);
+    put_u64(&buffer[12], hash);
+    put_u16(&buffer[20], surface->w);
+    put_u16(&buffer[22], surface->h);
+    put_u32(&buffer[24], surface->pitch);
+    put_u32(&buffer[28], PACK_PIXELS);
+
+    put_tables(&buffer[PACK_LEGEND], legend, theme.colors);
+
+    SDL_LockSurface(surface);
+    memcpy(&buffer[PACK_PIXELS], surface->pixels, pixels);
+    SDL_UnlockSurface(surface);
+
+    SDL_FreeSurface(surface);
+
+
+    // Write to a temporary file and rename over the old one, so that
+    // a pack which is still mapped (or a failed write) is never clobbered.
+    const std::string tmp = path + ".tmp";
+
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        fprintf(stderr, "bake_pack Error: could not open %s\n", tmp.c_str());
+        return false;
+    }
+
+    const bool written = fwrite(&buffer[0], 1, buffer.size(), f) == buffer.size();
+    if (fclose(f) != 0 || !written) {
+        fprintf(stderr, "bake_pack Error: could not write %s\n", tmp.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename will not replace an existing file here
+    remove(path.c_str());
+#endif
+
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "bake_pack Error: could not replace %s\n", path.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/* Implementation of AssetPack */
+
+
+AssetPack::AssetPack()
+    : base{nullptr}, size{0}, mapped{false} { }
+
+AssetPack::~AssetPack() { close(); }
+
+
+bool AssetPack::open(const std::string &path) {
+
+    close();
+
+#ifdef _WIN32
+
+    // No mmap here, so read the file in one go instead.
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return false;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    if (buffer == nullptr || fread(buffer, 1, size, f) != size) {
+        fprintf(stderr, "AssetPack Error: could not read %s\n", path.c_str());
+        free(buffer);
+        fclose(f);
+        size = 0;
+        return false;
+    }
+
+    fclose(f);
+    base = buffer;
+
+#else
+
+    // a missing pack is expected the first time, so not an error
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "AssetPack Error: could not stat %s\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "AssetPack Error: could not map %s\n", path.c_str());
+        return false;
+    }
+
+    // the whole thing is about to be uploaded, front to back
+    madvise(addr, st.st_size, MADV_WILLNEED);
+
+    base = static_cast<const uint8_t *>(addr);
+    size = st.st_size;
+
+#endif
+
+    mapped = true;
+
+
+    /* Check everything up front, so nothing handed out can be out of bounds */
+
+    if (size < PACK_PIXELS || memcmp(base, PACK_MAGIC, 4) != 0) {
+        fprintf(stderr, "AssetPack Error: %s is not an asset pack\n", path.c_str());
+        close();
+        return false;
+    }
+
+    // a pack from another build, with a different set of tiles or colors, is stale
+    if (get_u16(base + 4) != PACK_VERSION || get_u16(base + 6) != TILE_COUNT
+     || get_u16(base + 8) != COLOR_COUNT  || get_u32(base + 28) != PACK_PIXELS) {
+        close();
+        return false;
+    }
+
+    const uint16_t w     = get_u16(base + 20);
+    const uint16_t h     = get_u16(base + 22);
+    const uint32_t pitch = get_u32(base + 24);
+
+    if (pitch < 4u * w || PACK_PIXELS + (size_t)pitch * h > size) {
+        fprintf(stderr, "AssetPack Error: %s has truncated pixels\n", path.c_str());
+        close();
+        return false;
+    }
+
+    // the backends read tiles straight from the pixels, wherever the legend says
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+        const uint8_t *entry = base + PACK_LEGEND + t * PACK_LEGEND_ENTRY;
+        if ((uint32_t)get_u16(entry) + get_u16(entry + 4) > w || (uint32_t)get_u16(entry + 2) + get_u16(entry + 6) > h) {
+            fprintf(stderr, "AssetPack Error: %s has tile %zu outside its pixels\n", path.c_str(), t);
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void AssetPack::close() {
+
+    if (mapped) {
+#ifdef _WIN32
+        free(const_cast<uint8_t *>(base));
+#else
+        munmap(const_cast<uint8_t *>(base), size);
+#endif
+    }
+
+    base = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+
+bool AssetPack::is_open() const { return mapped; }
+
+uint64_t AssetPack::content_hash() const { return mapped ? get_u64(base + 12) : 0; }
+
+
+SDL_Surface *AssetPack::surface() const {
+
+    if (!mapped) return nullptr;
+
+    // SDL only reads from the pixels of a surface it did not allocate,
+    // so pointing it at the read only mapping is safe
+    SDL_Surface *s = SDL_CreateRGBSurfaceWithFormatFrom(
+        const_cast<uint8_t *>(base + PACK_PIXELS),
+        get_u16(base + 20), get_u16(base + 22), 32, get_u32(base + 24),
+        SDL_PIXELFORMAT_ARGB8888
+    );
+
+    if (s == nullptr) {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormatFrom Error: %s\n", SDL_GetError());
+    }
+
+    return s;
+}
+
+
+TileLegend AssetPack::legend() const {
+
+    TileLegend legend;
+
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+        const uint8_t *entry = base + PACK_LEGEND + t * PACK_LEGEND_ENTRY;
+        legend[t] = SDL_Rect{ get_u16(entry), get_u16(entry + 2), get_u16(entry + 4), get_u16(entry + 6) };
+    }
+
+    return legend;
+}
+
+
+Palette *AssetPack::palette() const {
+
+    Palette *palette = new Palette(COLOR_COUNT);
+
+    for (size_t c = 0; c < COLOR_COUNT; c++) {
+        const uint8_t *entry = base + PACK_PALETTE + c * PACK_PALETTE_ENTRY;
+        palette->emplace(PaletteColor(c), ColorRGBA(entry[0], entry[1], entry[2], entry[3]));
+    }
+
+    return palette;
+}
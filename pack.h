@@ -0,0 +1,81 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+
+#include "types.h"
+#include "render.h"
+#include "theme.h"
+
+
+/*
+    A baked asset pack: a tile map's pixels, already converted
+    to the format the renderer wants, along with the region of
+    every tile and the palette, all in one file.
+
+    The file is laid out to be mapped into memory and used where
+    it lies, so that starting the game involves no image decoding
+    and no building of hash maps. Each pack records a hash of the
+    files and tables it was baked from, so a pack which no longer
+    matches them can be noticed and baked again.
+*/
+
+
+/*
+    Hash the sources a pack is baked from: the raw bytes of
+    each texture in `theme`, its tile regions and palette, and
+    the pack format itself. Returns 0 if a texture could not be read.
+*/
+uint64_t pack_source_hash(const Theme &theme);
+
+
+/*
+    Bake a pack from a theme, packing its tilesets into one atlas,
+    and write it to `path`. Does not need a renderer, so it
+    may be run from a worker thread or a build step.
+*/
+bool bake_pack(const Theme &theme, const std::string &path);
+
+
+/*
+    A pack file, memory mapped. Everything handed out by it
+    points into the mapping, so it must stay open for as long
+    as they are in use.
+*/
+class AssetPack {
+public:
+
+    AssetPack();
+    ~AssetPack();
+
+    AssetPack(const AssetPack &) = delete;
+    AssetPack &operator=(const AssetPack &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool is_open() const;
+
+    /* The hash of the sources this pack was baked from */
+    uint64_t content_hash() const;
+
+    /*
+        A surface over the pixels in the pack, without copying
+        them. Belongs to the caller, who must free it before the
+        pack is closed.
+    */
+    SDL_Surface *surface() const;
+
+    TileLegend legend() const;
+
+    /* A new palette, which belongs to the caller */
+    Palette *palette() const;
+
+private:
+
+    const uint8_t *base;
+    size_t         size;
+    bool           mapped;
+
+};
@@ -0,0 +1,142 @@
+
+#include <vector>
+#include <cmath>
+
+#ifdef __SSE__
+    #include <xmmintrin.h>
+#endif
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+#include "types.h"
+#include "style.h"
+#include "render.h"
+#include "dungeon.h"
+#include "particles.h"
+
+
+
+ParticlePool::ParticlePool(uint32_t capacity)
+    : count{0}, _capacity{capacity}
+    , x(capacity), y(capacity), vx(capacity), vy(capacity)
+    , gravity(capacity), life(capacity), lifespan(capacity), scale(capacity)
+    , glyph(capacity), color(capacity)
+    , rng(1) { }
+
+
+uint32_t ParticlePool::size()     const { return count; }
+uint32_t ParticlePool::capacity() const { return _capacity; }
+
+void ParticlePool::clear() { count = 0; }
+
+
+bool ParticlePool::emit(Tile t, float px, float py, float pvx, float pvy, float plife,
+                        ColorRGBA c, float g, float s) {
+
+    if (count == _capacity || plife <= 0) return false;
+
+    const uint32_t i = count++;
+    x[i]  = px;    y[i]  = py;
+    vx[i] = pvx;   vy[i] = pvy;
+    gravity[i] = g;
+    life[i]    = lifespan[i] = plife;
+    scale[i]   = s;
+    glyph[i]   = t;
+    color[i]   = c;
+    return true;
+}
+
+
+void ParticlePool::burst(Tile t, float px, float py, uint16_t n, float speed, float plife, const Style &style) {
+
+    const ColorRGBA c = style.color();
+
+    for (uint16_t k = 0; k < n; k++) {
+        const float angle = rng.range(0, 360) * (float)M_PI / 180;
+        const float v     = speed * (50 + rng.range(0, 51)) / 100;
+        const float l     = plife * (75 + rng.range(0, 51)) / 100;
+
+        // half sized, and falling as they fly
+        if (!emit(t, px, py, v * std::cos(angle), v * std::sin(angle), l, c, 4 * speed, 0.5f)) return;
+    }
+}
+
+
+void ParticlePool::number(int32_t value, float px, float py, const Style &style) {
+
+    const ColorRGBA c = style.color();
+
+    Tile digits[12];
+    uint8_t n = 0;
+
+    uint32_t magnitude = value < 0 ? -(int64_t)value : value;
+    do {
+        digits[n++] = Tile(uint8_t(Tile::ALPHANUM_0) + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) digits[n++] = Tile::PUNCT_MINUS;
+
+    // half sized digits, centered over (x, y) and drifting upwards
+    const float left = px + 0.5f - n * 0.25f;
+    for (uint8_t k = 0; k < n; k++)
+        emit(digits[n - 1 - k], left + k * 0.5f, py, 0, -1.5f, 0.8f, c, 0, 0.5f);
+}
+
+
+void ParticlePool::remove(uint32_t i) {
+    const uint32_t last = --count;
+
+    x[i]  = x[last];    y[i]  = y[last];
+    vx[i] = vx[last];   vy[i] = vy[last];
+    gravity[i]  = gravity[last];
+    life[i]     = life[last];
+    lifespan[i] = lifespan[last];
+    scale[i]    = scale[last];
+    glyph[i]    = glyph[last];
+    color[i]    = color[last];
+}
+
+
+void ParticlePool::update(float dt) {
+
+    uint32_t i = 0;
+
+#ifdef __SSE__
+    const __m128 step = _mm_set1_ps(dt);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 nvx = _mm_loadu_ps(&vx[i]);
+        const __m128 nvy = _mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_mul_ps(_mm_loadu_ps(&gravity[i]), step));
+
+        _mm_storeu_ps(&vy[i], nvy);
+        _mm_storeu_ps(&x[i],    _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_mul_ps(nvx, step)));
+        _mm_storeu_ps(&y[i],    _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(nvy, step)));
+        _mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), step));
+    }
+#endif
+
+    for (; i < count; i++) {
+        vy[i]   += gravity[i] * dt;
+        x[i]    += vx[i] * dt;
+        y[i]    += vy[i] * dt;
+        life[i] -= dt;
+    }
+
+    // the particle moved into a hole still needs checking
+    for (i = 0; i < count;) {
+        if (life[i] <= 0) remove(i);
+        else              i++;
+    }
+}
+
+
+void ParticlePool::draw(TileBatch &batch, Pair<int16_t> origin) const {
+    for (uint32_t i = 0; i < count; i++) {
+        ColorRGBA c = color[i];
+        c.a = (uint8_t)(c.a * (life[i] / lifespan[i]));
+
+        batch.add(glyph[i], x[i] - origin.first, y[i] - origin.second, c, scale[i]);
+    }
+}
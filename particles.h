@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+#include "style.h"
+#include "render.h"
+#include "rng.h"
+
+
+/*
+    A fixed number of short lived visual effects, such as
+    sparks, trails and floating numbers, each drawn as a tile.
+
+    Particles are kept as parallel arrays, updated four at a
+    time, and a particle which dies is replaced by the last
+    one so the live particles are always packed at the front.
+    Nothing is allocated after construction; once the pool is
+    full, new particles are simply not emitted.
+
+    Positions and velocities are in (fractional) tiles, and
+    times are in seconds.
+*/
+class ParticlePool {
+public:
+
+    explicit ParticlePool(uint32_t capacity);
+
+    /* Emit a single particle, returning false if the pool is full */
+    bool emit(Tile, float x, float y, float vx, float vy, float life,
+              ColorRGBA, float gravity = 0.0f, float scale = 1.0f);
+
+    /* `count` particles flying out from (x, y) in random directions, tinted by `style` */
+    void burst(Tile, float x, float y, uint16_t count, float speed, float life, const Style &style);
+
+    /* A number which floats up from (x, y) and fades, e.g. damage taken */
+    void number(int32_t value, float x, float y, const Style &style);
+
+    /* Move every particle on by `dt` seconds, removing the ones which died */
+    void update(float dt);
+
+    /* Add every particle to `batch`, fading as they die, with `origin` at the top left of the screen */
+    void draw(TileBatch &batch, Pair<int16_t> origin) const;
+
+    uint32_t size()     const;
+    uint32_t capacity() const;
+
+    void clear();
+
+private:
+
+    void remove(uint32_t i);
+
+    uint32_t count, _capacity;
+
+    std::vector<float> x, y, vx, vy, gravity, life, lifespan, scale;
+    std::vector<Tile>      glyph;
+    std::vector<ColorRGBA> color;
+
+    Rng rng;
+
+};
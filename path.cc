@@ -0,0 +1,516 @@
+
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "types.h"
+#include "grid.h"
+#include "fov.h"
+#include "path.h"
+
+
+
+void costs_from_tiles(const TileGrid &tiles, CostGrid &out) {
+    for (int y = 0; y < tiles.height(); y++) {
+        const Tile *row = tiles.row(y);
+        int16_t    *dst = out.row(y);
+        for (int x = 0; x < tiles.width(); x++)
+            dst[x] = is_opaque(row[x]) ? PATH_BLOCKED : 1;
+    }
+}
+
+
+/* a + b, where anything at or past PATH_BLOCKED stays there */
+static int16_t add_cost(int16_t a, int16_t b) {
+    // a blocked cell stays blocked even reached from below zero
+    if (a == PATH_BLOCKED || b == PATH_BLOCKED) return PATH_BLOCKED;
+    int32_t sum = (int32_t)a + b;
+    return sum >= PATH_BLOCKED ? PATH_BLOCKED : (int16_t)sum;
+}
+
+
+// Rounds of sweeps to run before finishing a map off with a wavefront
+static constexpr uint8_t SWEEP_ROUNDS = 2u;
+
+// Offsets to the eight neighbors of a cell
+static const int8_t NEIGHBOR_DX[8] = { -1,  0,  1, -1, 1, -1, 0, 1 };
+static const int8_t NEIGHBOR_DY[8] = { -1, -1, -1,  0, 0,  1, 1, 1 };
+
+
+
+/* Implementation of PathFinder */
+
+
+PathFinder::PathFinder(uint16_t width, uint16_t height)
+    : cost_so_far((size_t)width * height)
+    , came_from((size_t)width * height)
+    , seen((size_t)width * height, 0)
+    , query{0} { }
+
+
+bool PathFinder::find(const CostGrid &cost, Pair<int16_t> from, Pair<int16_t> to,
+                      std::vector<Pair<int16_t>> &out) {
+
+    out.clear();
+
+    if (!cost.in_bounds(from.first, from.second) || !cost.in_bounds(to.first, to.second))
+        return false;
+    if (cost.at(to.first, to.second) == PATH_BLOCKED)
+        return false;
+    if (from == to)
+        return true;
+
+    // Stamping cells with the query number saves clearing
+    // the scratch arrays before every search.
+    if (++query == 0) {
+        std::fill(seen.begin(), seen.end(), 0);
+        query = 1;
+    }
+
+    const int width = cost.width();
+    const uint32_t start = from.second * width + from.first;
+    const uint32_t goal  = to.second   * width + to.first;
+
+    // Chebyshev distance; admissible since every step costs at least 1
+    auto heuristic = [&](uint32_t i) -> int32_t {
+        return std::max(std::abs((int)(i % width) - to.first), std::abs((int)(i / width) - to.second));
+    };
+
+    typedef std::pair<int32_t, uint32_t> Entry; // (estimated total, cell)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    seen[start] = query;
+    cost_so_far[start] = 0;
+    came_from[start] = start;
+    open.push(Entry(heuristic(start), start));
+
+    while (!open.empty()) {
+
+        const Entry top = open.top();
+        open.pop();
+
+        const uint32_t i = top.second;
+        if (i == goal) break;
+
+        // skip entries made stale by a cheaper route found later
+        if (top.first > cost_so_far[i] + heuristic(i)) continue;
+
+        const int x = i % width, y = i / width;
+
+        for (uint8_t k = 0; k < 8; k++) {
+            const int nx = x + NEIGHBOR_DX[k], ny = y + NEIGHBOR_DY[k];
+            if (!cost.in_bounds(nx, ny)) continue;
+
+            const int16_t step = cost.at(nx, ny);
+            if (step == PATH_BLOCKED) continue;
+
+            const uint32_t n = ny * width + nx;
+            const int32_t  g = cost_so_far[i] + step;
+
+            if (seen[n] != query || g < cost_so_far[n]) {
+                seen[n] = query;
+                cost_so_far[n] = g;
+                came_from[n] = i;
+                open.push(Entry(g + heuristic(n), n));
+            }
+        }
+    }
+
+    if (seen[goal] != query) return false;
+
+    for (uint32_t i = goal; i != start; i = came_from[i])
+        out.push_back(std::make_pair((int16_t)(i % width), (int16_t)(i / width)));
+
+    std::reverse(out.begin(), out.end());
+
+    return true;
+}
+
+
+
+/*
+    Dijkstra maps
+
+    A full computation sweeps over the map forwards and backwards,
+    relaxing each cell against its neighbors, until nothing changes.
+    Relaxing a row against the row before (or after) it has no
+    dependencies between cells, so it is done 8 cells at a time
+    with SSE2; only the relaxation along the row itself is serial.
+*/
+
+
+/* Relax a single cell of row `c` against its three neighbors in row `p` */
+static bool relax_cell(int16_t *c, const int16_t *p, const int16_t *k, int x, int width) {
+    int16_t m = p[x];
+    if (x > 0)         m = std::min(m, p[x - 1]);
+    if (x < width - 1) m = std::min(m, p[x + 1]);
+
+    const int16_t v = add_cost(m, k[x]);
+    if (v < c[x]) {
+        c[x] = v;
+        return true;
+    }
+    return false;
+}
+
+
+/* Relax every cell of row `c` against row `p`, with `k` the costs of row `c` */
+static bool relax_row(int16_t *c, const int16_t *p, const int16_t *k, int width) {
+
+    bool changed = relax_cell(c, p, k, 0, width);
+    int x = 1;
+
+#ifdef __SSE2__
+    const __m128i blocked = _mm_set1_epi16(PATH_BLOCKED);
+    __m128i any = _mm_setzero_si128();
+
+    for (; x + 8 <= width - 1; x += 8) {
+        const __m128i left  = _mm_loadu_si128((const __m128i *)(p + x - 1));
+        const __m128i mid   = _mm_loadu_si128((const __m128i *)(p + x));
+        const __m128i right = _mm_loadu_si128((const __m128i *)(p + x + 1));
+        const __m128i step  = _mm_loadu_si128((const __m128i *)(k + x));
+        const __m128i old   = _mm_loadu_si128((const __m128i *)(c + x));
+
+        // a signed saturating add pins sums past it at PATH_BLOCKED,
+        // but distances below zero (from negative goals) can bring a
+        // blocked step or source back under it, so those are pinned
+        // there as well, as add_cost does
+        const __m128i best = _mm_min_epi16(_mm_min_epi16(left, mid), right);
+        const __m128i stop = _mm_or_si128(_mm_cmpeq_epi16(best, blocked), _mm_cmpeq_epi16(step, blocked));
+        const __m128i sum  = _mm_or_si128(_mm_andnot_si128(stop, _mm_adds_epi16(best, step)),
+                                          _mm_and_si128(stop, blocked));
+        const __m128i next = _mm_min_epi16(old, sum);
+
+        any = _mm_or_si128(any, _mm_xor_si128(next, old));
+        _mm_storeu_si128((__m128i *)(c + x), next);
+    }
+
+    changed |= _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+#endif
+
+    for (; x < width; x++)
+        changed |= relax_cell(c, p, k, x, width);
+
+    return changed;
+}
+
+
+DijkstraMap::DijkstraMap(uint16_t width, uint16_t height)
+    : dist(width, height, PATH_BLOCKED) { }
+
+
+void DijkstraMap::clear_goals() { goals.clear(); }
+
+void DijkstraMap::add_goal(int16_t x, int16_t y, int16_t value) {
+    goals.push_back(Goal{ x, y, value });
+}
+
+int16_t DijkstraMap::at(int16_t x, int16_t y) const { return dist.at(x, y); }
+
+
+/* Flag a row, and the rows either side of it, as needing another look */
+void DijkstraMap::mark_row(int y) {
+    if (y > 0)                 pending_rows[y - 1] = 1;
+    pending_rows[y] = 1;
+    if (y < dist.height() - 1) pending_rows[y + 1] = 1;
+}
+
+
+/*
+    Relax a row one step against the rows above and below it and
+    against itself, so that a row left unchanged by this (and by
+    the pass along it) agrees with all eight neighbors of every cell.
+*/
+bool DijkstraMap::relax_around(int y, const CostGrid &cost) {
+    const int width = dist.width();
+    int16_t       *d = dist.row(y);
+    const int16_t *k = cost.row(y);
+
+    bool changed = false;
+    if (y > 0)                 changed |= relax_row(d, dist.row(y - 1), k, width);
+    if (y < dist.height() - 1) changed |= relax_row(d, dist.row(y + 1), k, width);
+    changed |= relax_row(d, d, k, width);
+
+    return changed;
+}
+
+
+bool DijkstraMap::sweep_forward(const CostGrid &cost) {
+    bool changed = false;
+    const int width = dist.width();
+
+    for (int y = 0; y < dist.height(); y++) {
+
+        // nothing in or around this row has changed since it was last relaxed
+        if (!pending_rows[y]) continue;
+        pending_rows[y] = 0;
+
+        int16_t       *d = dist.row(y);
+        const int16_t *k = cost.row(y);
+
+        bool row_changed = relax_around(y, cost);
+
+        for (int x = 1; x < width; x++) {
+            const int16_t v = add_cost(d[x - 1], k[x]);
+            if (v < d[x]) { d[x] = v; row_changed = true; }
+        }
+
+        if (row_changed) {
+            mark_row(y);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+bool DijkstraMap::sweep_backward(const CostGrid &cost) {
+    bool changed = false;
+    const int width = dist.width();
+
+    for (int y = dist.height() - 1; y >= 0; y--) {
+
+        if (!pending_rows[y]) continue;
+        pending_rows[y] = 0;
+
+        int16_t       *d = dist.row(y);
+        const int16_t *k = cost.row(y);
+
+        bool row_changed = relax_around(y, cost);
+
+        for (int x = width - 2; x >= 0; x--) {
+            const int16_t v = add_cost(d[x + 1], k[x]);
+            if (v < d[x]) { d[x] = v; row_changed = true; }
+        }
+
+        if (row_changed) {
+            mark_row(y);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+void DijkstraMap::compute(const CostGrid &cost) {
+
+    dist.fill(PATH_BLOCKED);
+    pending_rows.assign(dist.height(), 0);
+
+    for (const Goal &g : goals) {
+        if (dist.in_bounds(g.x, g.y)) {
+            dist.at(g.x, g.y) = std::min(dist.at(g.x, g.y), g.value);
+            mark_row(g.y);
+        }
+    }
+
+    // Each pair of sweeps settles every path which doesn't double
+    // back on itself, and rows which have settled are skipped after.
+    // That quickly covers open areas, but winding corridors would take
+    // a round per bend, so after a couple of rounds what is left...
+    bool changed = true;
+    for (uint8_t round = 0; changed && round < SWEEP_ROUNDS; round++) {
+        changed  = sweep_forward(cost);
+        changed |= sweep_backward(cost);
+    }
+
+    if (!changed) return;
+
+    // ...is finished off by spreading out from the unsettled rows. Any
+    // cell which could still improve is in a pending row, and the cell
+    // it would improve from is in that row or the rows either side.
+    const int width = dist.width();
+
+    for (int y = 0; y < dist.height(); y++) {
+        const bool near_pending = pending_rows[y]
+            || (y > 0 && pending_rows[y - 1])
+            || (y < dist.height() - 1 && pending_rows[y + 1]);
+        if (!near_pending) continue;
+
+        const int16_t *d = dist.row(y);
+        for (int x = 0; x < width; x++)
+            if (d[x] != PATH_BLOCKED) queue.push_back(y * width + x);
+    }
+
+    lower(cost);
+}
+
+
+/*
+    Spread lowered distances outward from the cells in `queue`.
+    Cells are handled in order of distance using one bucket per
+    distance, so (as in Dijkstra's algorithm) each settles only once.
+*/
+void DijkstraMap::lower(const CostGrid &cost) {
+
+    const int width = dist.width();
+    int16_t *d = dist.data();
+
+    // Goals below zero (to flee from them) make for distances below
+    // zero, so bucket 0 holds the lowest distance queued. Nothing
+    // spreads to a distance below that, as no step costs less than 0.
+    int32_t base = 0;
+    for (uint32_t i : queue) base = std::min<int32_t>(base, d[i]);
+
+    auto bucket_of = [base](int16_t v) { return (size_t)(v - base); };
+
+    size_t lowest = buckets.size();
+
+    for (uint32_t i : queue) {
+        const size_t b = bucket_of(d[i]);
+        if (b >= buckets.size()) buckets.resize(b + 1);
+        buckets[b].push_back(i);
+        lowest = std::min(lowest, b);
+    }
+    queue.clear();
+
+    for (size_t b = lowest; b < buckets.size(); b++) {
+
+        // the bucket can grow while it is walked (for zero cost cells)
+        for (size_t j = 0; j < buckets[b].size(); j++) {
+
+            const uint32_t i = buckets[b][j];
+            if (bucket_of(d[i]) != b) continue; // improved since it was queued
+
+            const int x = i % width, y = i / width;
+
+            for (uint8_t k = 0; k < 8; k++) {
+                const int nx = x + NEIGHBOR_DX[k], ny = y + NEIGHBOR_DY[k];
+                if (!dist.in_bounds(nx, ny)) continue;
+
+                const uint32_t n = ny * width + nx;
+                const int16_t  v = add_cost(d[i], cost.data()[n]);
+
+                if (v < d[n]) {
+                    d[n] = v;
+                    const size_t nb = bucket_of(v);
+                    if (nb >= buckets.size()) buckets.resize(nb + 1);
+                    buckets[nb].push_back(n);
+                }
+            }
+        }
+
+        buckets[b].clear();
+    }
+}
+
+
+void DijkstraMap::changed(const CostGrid &cost, int16_t x, int16_t y) {
+
+    if (!dist.in_bounds(x, y)) return;
+
+    const int width = dist.width();
+    int16_t *d = dist.data();
+
+    /*
+        First raise every cell whose distance may have been reached
+        through (x, y), by following neighbors whose distance is
+        exactly one step more. These are reset to unreachable...
+    */
+
+    raised.clear();
+    raised.push_back(y * width + x);
+
+    // the old distances of the raised cells, to find their dependents
+    std::vector<int16_t> &old = raised_from;
+    old.clear();
+    old.push_back(d[raised[0]]);
+    d[raised[0]] = PATH_BLOCKED;
+
+    for (size_t head = 0; head < raised.size(); head++) {
+
+        const uint32_t i = raised[head];
+        if (old[head] == PATH_BLOCKED) continue; // nothing depends on an unreachable cell
+
+        const int cx = i % width, cy = i / width;
+
+        for (uint8_t k = 0; k < 8; k++) {
+            const int nx = cx + NEIGHBOR_DX[k], ny = cy + NEIGHBOR_DY[k];
+            if (!dist.in_bounds(nx, ny)) continue;
+
+            const uint32_t n = ny * width + nx;
+            if (d[n] != PATH_BLOCKED && d[n] == add_cost(old[head], cost.data()[n])) {
+                raised.push_back(n);
+                old.push_back(d[n]);
+                d[n] = PATH_BLOCKED;
+            }
+        }
+    }
+
+    /*
+        ...then give each raised cell the best distance its
+        untouched neighbors can offer, restore the goals, and let
+        the lowered distances spread back out from there.
+    */
+
+    for (uint32_t i : raised) {
+        const int cx = i % width, cy = i / width;
+
+        int16_t best = PATH_BLOCKED;
+        for (uint8_t k = 0; k < 8; k++) {
+            const int nx = cx + NEIGHBOR_DX[k], ny = cy + NEIGHBOR_DY[k];
+            if (dist.in_bounds(nx, ny)) best = std::min(best, dist.at(nx, ny));
+        }
+
+        const int16_t v = add_cost(best, cost.data()[i]);
+        if (v < d[i]) {
+            d[i] = v;
+            queue.push_back(i);
+        }
+    }
+
+    for (const Goal &g : goals) {
+        if (dist.in_bounds(g.x, g.y) && g.value < dist.at(g.x, g.y)) {
+            dist.at(g.x, g.y) = g.value;
+            queue.push_back(g.y * width + g.x);
+        }
+    }
+
+    lower(cost);
+}
+
+
+Pair<int16_t> DijkstraMap::downhill(int16_t x, int16_t y) const {
+
+    Pair<int16_t> best = std::make_pair(x, y);
+    int16_t best_dist = dist.at(x, y);
+
+    for (uint8_t k = 0; k < 8; k++) {
+        const int nx = x + NEIGHBOR_DX[k], ny = y + NEIGHBOR_DY[k];
+        if (dist.in_bounds(nx, ny) && dist.at(nx, ny) < best_dist) {
+            best_dist = dist.at(nx, ny);
+            best = std::make_pair((int16_t)nx, (int16_t)ny);
+        }
+    }
+
+    return best;
+}
+
+
+void DijkstraMap::compute_all(const std::vector<DijkstraMap *> &maps, const CostGrid &cost, uint8_t threads) {
+
+    threads = std::max<uint8_t>(1, std::min<size_t>(threads, maps.size()));
+
+    auto work = [&](uint8_t first) {
+        for (size_t i = first; i < maps.size(); i += threads)
+            maps[i]->compute(cost);
+    };
+
+    // the calling thread takes a share of the maps too
+    std::vector<std::thread> workers;
+    for (uint8_t t = 1; t < threads; t++)
+        workers.push_back(std::thread(work, t));
+
+    work(0);
+
+    for (auto &worker : workers) worker.join();
+}
@@ -0,0 +1,113 @@
+
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+
+
+/*
+    The cost of entering each cell of a map.
+    Blocked cells hold `PATH_BLOCKED`.
+*/
+typedef Grid<int16_t> CostGrid;
+
+// The cost of a cell which can't be entered, and the distance to
+// a cell which can't reach any goal. Sums saturate at this value.
+static constexpr int16_t PATH_BLOCKED = 0x7FFF;
+
+/* Fill `out` (of the same size) with the cost of walking over each tile */
+void costs_from_tiles(const TileGrid &, CostGrid &out);
+
+
+
+/*
+    Shortest paths between two cells with A*, moving in
+    eight directions. Scratch space is kept between queries,
+    so one finder should be reused for many of them.
+*/
+class PathFinder {
+public:
+
+    PathFinder(uint16_t width, uint16_t height);
+
+    /*
+        Find a path from `from` to `to`, storing the cells
+        after `from` (up to and including `to`) in `out`.
+    */
+    bool find(const CostGrid &, Pair<int16_t> from, Pair<int16_t> to,
+              std::vector<Pair<int16_t>> &out);
+
+private:
+
+    std::vector<int32_t>  cost_so_far;
+    std::vector<uint32_t> came_from;
+    std::vector<uint32_t> seen;      // the query each cell was last touched by
+    uint32_t              query;
+
+};
+
+
+
+/*
+    A "Dijkstra map": the distance from every cell to the nearest
+    of any number of goals. Any number of actors can then walk
+    towards (or away from) the goals by stepping downhill,
+    without a search of their own.
+*/
+class DijkstraMap {
+public:
+
+    DijkstraMap(uint16_t width, uint16_t height);
+
+    void clear_goals();
+
+    /*
+        A goal starts at `value` rather than 0, which may be below
+        zero, e.g. for a flee map built from the distances to the
+        things to flee from, scaled by a negative factor.
+    */
+    void add_goal(int16_t x, int16_t y, int16_t value = 0);
+
+    /* Compute every distance from scratch */
+    void compute(const CostGrid &);
+
+    /* Update the distances after the cost of the cell (x, y) changed */
+    void changed(const CostGrid &, int16_t x, int16_t y);
+
+    int16_t at(int16_t x, int16_t y) const;
+
+    /* The neighbor of (x, y) closest to a goal, or (x, y) itself if none is */
+    Pair<int16_t> downhill(int16_t x, int16_t y) const;
+
+    /* Compute several independent maps at once, split over `threads` threads */
+    static void compute_all(const std::vector<DijkstraMap *> &, const CostGrid &, uint8_t threads);
+
+private:
+
+    void mark_row(int y);
+    bool relax_around(int y, const CostGrid &);
+
+    bool sweep_forward(const CostGrid &);
+    bool sweep_backward(const CostGrid &);
+
+    void lower(const CostGrid &);
+
+    Grid<int16_t> dist;
+
+    struct Goal { int16_t x, y, value; };
+    std::vector<Goal> goals;
+
+    // rows which may still improve during a full computation
+    std::vector<uint8_t> pending_rows;
+
+    // scratch space for spreading out lowered distances
+    std::vector<uint32_t>              queue;
+    std::vector<std::vector<uint32_t>> buckets;
+
+    // scratch space for incremental updates
+    std::vector<uint32_t> raised;
+    std::vector<int16_t>  raised_from;
+
+};
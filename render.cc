@@ -1,7 +1,6 @@
 
 #include <SDL2/SDL.h>
 #include <string.h>
-#include <unordered_map>
 #include <memory>
 
 #include "types.h"
@@ -9,25 +8,13 @@
 #include "style.h"
 #include "render.h"
 #include "mappings.h"
+#include "tint.h"
+#include "text.h"
 
 
 /* Implementation of TileMap */
 
 TileMap::TileMap(const std::string &tex_file, const Pair<uint8_t> tile_size, const TextureMapping *tex_map) {
-    
-    /* Compute rectangles based on the texture mapping and tile size */
-    
-    for (auto const& it : *tex_map) {
-        Tile t = it.first;
-        Pair<uint8_t> p = it.second;
-        legend.emplace(t, SDL_Rect{
-            p.first  * tile_size.first,
-            p.second * tile_size.second,
-            tile_size.first,
-            tile_size.second
-        });
-    }
-
 
     /* Load in the texture from the specified file */
 
@@ -38,21 +25,51 @@ TileMap::TileMap(const std::string &tex_file, const Pair<uint8_t> tile_size, con
         throw SDL_GetError();
     }
 
-    SDL_Texture *file_texture = SDL_CreateTextureFromSurface(renderer, file_surface);
+    legend = legend_from_mapping(tile_size, tex_map);
+    upload(file_surface);
+
+    SDL_FreeSurface(file_surface);
+}
+
+TileMap::TileMap(SDL_Surface *surface, const Pair<uint8_t> tile_size, const TextureMapping *tex_map)
+    : legend(legend_from_mapping(tile_size, tex_map)) {
+    upload(surface);
+}
+
+TileMap::TileMap(SDL_Surface *surface, const TileLegend &legend)
+    : legend(legend) {
+    upload(surface);
+}
+
+void TileMap::upload(SDL_Surface *surface) {
+
+    if (renderer == nullptr) {
+        SDL_Surface *copy = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+
+        if (copy == nullptr) {
+            fprintf(stderr, "SDL_ConvertSurfaceFormat Error: %s", SDL_GetError());
+            throw SDL_GetError();
+        }
+
+        _pixels = std::shared_ptr<SDL_Surface>(copy, SDL_FreeSurface);
+        return;
+    }
+
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
 
-    if (file_texture == nullptr) {
+    if (texture == nullptr) {
         fprintf(stderr, "SDL_CreateTextureFromSurface Error: %s", SDL_GetError());
         throw SDL_GetError();
     }
 
-    SDL_FreeSurface(file_surface);
-
-    _atlas = file_texture;
+    _atlas = std::shared_ptr<SDL_Texture>(texture, SDL_DestroyTexture);
 }
 
-SDL_Texture *TileMap::atlas() const { return _atlas; }
+SDL_Texture *TileMap::atlas() const { return _atlas.get(); }
 
-SDL_Rect TileMap::region(Tile t) const { return legend.at(t); }
+const SDL_Surface *TileMap::pixels() const { return _pixels.get(); }
+
+SDL_Rect TileMap::region(Tile t) const { return legend[static_cast<size_t>(t)]; }
 
 
 
@@ -62,23 +79,30 @@ SDL_Rect TileMap::region(Tile t) const { return legend.at(t); }
 RenderConfig::RenderConfig(Palette &palette, Pair<uint8_t> render_scale)
     : render_scale{render_scale}
     , _palette{new Palette(palette)}
+    , _generation{0}
     { }
 
 
 RenderConfig::RenderConfig(Palette &&palette, Pair<uint8_t> render_scale)
     : render_scale{render_scale}
     , _palette{&palette}
+    , _generation{0}
     { }
 
 
+RenderConfig::~RenderConfig() { }
+
+
 Palette &RenderConfig::palette() { return *_palette; }
 
 void RenderConfig::palette(Palette *&new_palette) {
     _palette = std::unique_ptr<Palette>(new Palette(*new_palette));
+    _generation++;
 }
 
 void RenderConfig::palette(Palette *&&new_palette) {
     _palette = std::unique_ptr<Palette>(new_palette);
+    _generation++;
 }
 
 
@@ -86,16 +110,61 @@ const TileMap &RenderConfig::tile_map() { return *_tile_map; }
 
 void RenderConfig::tile_map(TileMap *&new_tile_map) {
     _tile_map = std::unique_ptr<TileMap>(new TileMap(*new_tile_map));
+    _generation++;
 }
 
 void RenderConfig::tile_map(TileMap *&&new_tile_map) {
     _tile_map = std::unique_ptr<TileMap>(new_tile_map);
+    _generation++;
 }
 
+bool RenderConfig::has_tile_map() const { return _tile_map != nullptr; }
+
+uint32_t RenderConfig::generation() const { return _generation; }
+
+
+TintCache *RenderConfig::tint_cache() { return _tint_cache.get(); }
+
+void RenderConfig::tint_cache(TintCache *&&new_tint_cache) {
+    _tint_cache = std::unique_ptr<TintCache>(new_tint_cache);
+}
+
+
+RenderBackend *RenderConfig::backend() { return _backend.get(); }
+
+void RenderConfig::backend(RenderBackend *&&new_backend) {
+    _backend = std::unique_ptr<RenderBackend>(new_backend);
+}
+
+
+RenderBackend::~RenderBackend() { }
+
+bool RenderBackend::read(uint32_t *, uint16_t, uint16_t) const { return false; }
+
 
 /* Other rendering functions */
 
 
+bool begin_frame() {
+    if (RenderBackend *backend = render_config.backend()) return backend->clear();
+
+    if (SDL_RenderClear(renderer) < 0) {
+        fprintf(stderr, "SDL_RenderClear Error: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+
+bool end_frame() {
+    if (RenderBackend *backend = render_config.backend()) return backend->present();
+
+    SDL_RenderPresent(renderer);
+    return true;
+}
+
+
+
 /* Draw a single tile `t` at the screen position `pos` with style `s` */
 bool draw_tile(Tile t, Pair<int8_t> pos, const Style &s) {
 
@@ -108,8 +177,6 @@ bool draw_tile(Tile t, Pair<int8_t> pos, const Style &s) {
     const Pair<int16_t> offset = s.offset();
     const Pair<float>   scale  = s.scale();
 
-    SDL_Texture *tex = render_config.tile_map().atlas();
-
     // Compute the position where we should
     // be drawing the tile.
     SDL_Rect dest{
@@ -119,11 +186,22 @@ bool draw_tile(Tile t, Pair<int8_t> pos, const Style &s) {
         (int)(TILE_RENDER_HEIGHT * scale.second),        // h
     };
 
-    SDL_Rect src = render_config.tile_map().region(t);
+    // Other backends only need to know where, and in what color
+    if (RenderBackend *backend = render_config.backend()) return backend->draw(t, dest, color);
 
-    // Set the color modifier so we use the correct color
-    SDL_SetTextureColorMod(tex, color.r, color.g, color.b);
-    SDL_SetTextureAlphaMod(tex, color.a);
+    SDL_Texture *tex = render_config.tile_map().atlas();
+
+    SDL_Rect src;
+
+    // Tiles in colors which rarely change come ready tinted,
+    // and otherwise the color modifier does the tinting
+    TintCache *tints = render_config.tint_cache();
+
+    if (!(tints && s.stable_color() && tints->find(t, color, tex, src))) {
+        src = render_config.tile_map().region(t);
+        SDL_SetTextureColorMod(tex, color.r, color.g, color.b);
+        SDL_SetTextureAlphaMod(tex, color.a);
+    }
 
     // Perform the draw
     if (SDL_RenderCopy(renderer, tex, &src, &dest) < 0) {
@@ -136,143 +214,206 @@ bool draw_tile(Tile t, Pair<int8_t> pos, const Style &s) {
 }
 
 
-bool draw_string(const std::string &str, Pair<int8_t> pos, const Style &s) {
-    static std::unordered_map<char, Tile> char_to_tile {
-        { 'a', Tile::ALPHANUM_A },
-        { 'b', Tile::ALPHANUM_B },
-        { 'c', Tile::ALPHANUM_C },
-        { 'd', Tile::ALPHANUM_D },
-        { 'e', Tile::ALPHANUM_E },
-        { 'f', Tile::ALPHANUM_F },
-        { 'g', Tile::ALPHANUM_G },
-        { 'h', Tile::ALPHANUM_H },
-        { 'i', Tile::ALPHANUM_I },
-        { 'j', Tile::ALPHANUM_J },
-        { 'k', Tile::ALPHANUM_K },
-        { 'l', Tile::ALPHANUM_L },
-        { 'm', Tile::ALPHANUM_M },
-        { 'n', Tile::ALPHANUM_N },
-        { 'o', Tile::ALPHANUM_O },
-        { 'p', Tile::ALPHANUM_P },
-        { 'q', Tile::ALPHANUM_Q },
-        { 'r', Tile::ALPHANUM_R },
-        { 's', Tile::ALPHANUM_S },
-        { 't', Tile::ALPHANUM_T },
-        { 'u', Tile::ALPHANUM_U },
-        { 'v', Tile::ALPHANUM_V },
-        { 'w', Tile::ALPHANUM_W },
-        { 'x', Tile::ALPHANUM_X },
-        { 'y', Tile::ALPHANUM_Y },
-        { 'z', Tile::ALPHANUM_Z },
-
-        { 'A', Tile::ALPHANUM_A_BOLD },
-        { 'B', Tile::ALPHANUM_B_BOLD },
-        { 'C', Tile::ALPHANUM_C_BOLD },
-        { 'D', Tile::ALPHANUM_D_BOLD },
-        { 'E', Tile::ALPHANUM_E_BOLD },
-        { 'F', Tile::ALPHANUM_F_BOLD },
-        { 'G', Tile::ALPHANUM_G_BOLD },
-        { 'H', Tile::ALPHANUM_H_BOLD },
-        { 'I', Tile::ALPHANUM_I_BOLD },
-        { 'J', Tile::ALPHANUM_J_BOLD },
-        { 'K', Tile::ALPHANUM_K_BOLD },
-        { 'L', Tile::ALPHANUM_L_BOLD },
-        { 'M', Tile::ALPHANUM_M_BOLD },
-        { 'N', Tile::ALPHANUM_N_BOLD },
-        { 'O', Tile::ALPHANUM_O_BOLD },
-        { 'P', Tile::ALPHANUM_P_BOLD },
-        { 'Q', Tile::ALPHANUM_Q_BOLD },
-        { 'R', Tile::ALPHANUM_R_BOLD },
-        { 'S', Tile::ALPHANUM_S_BOLD },
-        { 'T', Tile::ALPHANUM_T_BOLD },
-        { 'U', Tile::ALPHANUM_U_BOLD },
-        { 'V', Tile::ALPHANUM_V_BOLD },
-        { 'W', Tile::ALPHANUM_W_BOLD },
-        { 'X', Tile::ALPHANUM_X_BOLD },
-        { 'Y', Tile::ALPHANUM_Y_BOLD },
-        { 'Z', Tile::ALPHANUM_Z_BOLD },
-
-        { '0', Tile::ALPHANUM_0 },
-        { '1', Tile::ALPHANUM_1 },
-        { '2', Tile::ALPHANUM_2 },
-        { '3', Tile::ALPHANUM_3 },
-        { '4', Tile::ALPHANUM_4 },
-        { '5', Tile::ALPHANUM_5 },
-        { '6', Tile::ALPHANUM_6 },
-        { '7', Tile::ALPHANUM_7 },
-        { '8', Tile::ALPHANUM_8 },
-        { '9', Tile::ALPHANUM_9 },
-
-        { ' ',  Tile::PUNCT_SPACE     },
-        { '.',  Tile::PUNCT_FSTOP     },
-        { ',',  Tile::PUNCT_COMMA     },
-        { '`',  Tile::PUNCT_LQUOT     },
-        { '\'', Tile::PUNCT_RQUOT     },
-        { '!',  Tile::PUNCT_EMARK     },
-        { '?',  Tile::PUNCT_QMARK     },
-        { ':',  Tile::PUNCT_COLON     },
-        { '(',  Tile::PUNCT_LPAREN    },
-        { ')',  Tile::PUNCT_RPAREN    },
-        { '+',  Tile::PUNCT_PLUS      },
-        { '-',  Tile::PUNCT_MINUS     },
-        { '*',  Tile::PUNCT_MULTSMALL },
-        { '<',  Tile::PUNCT_LTSIGN    },
-        { '>',  Tile::PUNCT_GTSIGN    },
-        { '/',  Tile::PUNCT_SOLIDUS   },
-        { '$',  Tile::PUNCT_MONEY     },
+/* Implementation of TileBatch */
 
-    };
 
-    Tile t;
+void TileBatch::add(Tile t, float x, float y, ColorRGBA color, float scale) {
+    quads.push_back(Quad{ t, x, y, scale, color });
+}
+
+void TileBatch::clear() {
+    quads.clear();
+}
+
+size_t TileBatch::size() const {
+    return quads.size();
+}
+
+
+bool draw_tile_batch(TileBatch &batch) {
+
+    if (batch.quads.empty()) return true;
+
+    if (RenderBackend *backend = render_config.backend()) {
+        for (const TileBatch::Quad &q : batch.quads) {
+            const SDL_Rect dest{
+                (int)(q.x * TILE_RENDER_WIDTH),
+                (int)(q.y * TILE_RENDER_HEIGHT),
+                (int)(q.scale * TILE_RENDER_WIDTH),
+                (int)(q.scale * TILE_RENDER_HEIGHT),
+            };
+            if (!backend->draw(q.tile, dest, q.color)) return false;
+        }
+        return true;
+    }
+
+    SDL_Texture *tex = render_config.tile_map().atlas();
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+
+    int tex_w, tex_h;
+    if (SDL_QueryTexture(tex, nullptr, nullptr, &tex_w, &tex_h) < 0) {
+        fprintf(stderr, "SDL_QueryTexture Error: %s", SDL_GetError());
+        return false;
+    }
+
+    // every quad is two triangles over its four corners
+    while (batch.indices.size() < batch.quads.size() * 6) {
+        const int v = (int)(batch.indices.size() / 6 * 4);
+        for (int i : { 0, 1, 2, 2, 1, 3 }) batch.indices.push_back(v + i);
+    }
+
+    batch.vertices.clear();
+    for (const TileBatch::Quad &q : batch.quads) {
+
+        const SDL_Rect src = render_config.tile_map().region(q.tile);
+
+        const float u0 = (float)src.x / tex_w;
+        const float v0 = (float)src.y / tex_h;
+        const float u1 = (float)(src.x + src.w) / tex_w;
+        const float v1 = (float)(src.y + src.h) / tex_h;
+
+        const float x0 = q.x * TILE_RENDER_WIDTH;
+        const float y0 = q.y * TILE_RENDER_HEIGHT;
+        const float x1 = x0  + q.scale * TILE_RENDER_WIDTH;
+        const float y1 = y0  + q.scale * TILE_RENDER_HEIGHT;
+
+        const SDL_Color c{ q.color.r, q.color.g, q.color.b, q.color.a };
+
+        batch.vertices.push_back(SDL_Vertex{ { x0, y0 }, c, { u0, v0 } });
+        batch.vertices.push_back(SDL_Vertex{ { x1, y0 }, c, { u1, v0 } });
+        batch.vertices.push_back(SDL_Vertex{ { x0, y1 }, c, { u0, v1 } });
+        batch.vertices.push_back(SDL_Vertex{ { x1, y1 }, c, { u1, v1 } });
+    }
+
+    // the tints are in the vertices, so clear whatever `draw_tile` left on the atlas
+    SDL_SetTextureColorMod(tex, 0xFF, 0xFF, 0xFF);
+    SDL_SetTextureAlphaMod(tex, 0xFF);
+
+    if (SDL_RenderGeometry(renderer, tex,
+                           batch.vertices.data(), (int)batch.vertices.size(),
+                           batch.indices.data(),  (int)batch.quads.size() * 6) < 0) {
+        fprintf(stderr, "SDL_RenderGeometry Error: %s", SDL_GetError());
+        return false;
+    }
+
+#else
+
+    for (const TileBatch::Quad &q : batch.quads) {
+
+        SDL_Rect src = render_config.tile_map().region(q.tile);
+        SDL_Rect dest{
+            (int)(q.x * TILE_RENDER_WIDTH),
+            (int)(q.y * TILE_RENDER_HEIGHT),
+            (int)(q.scale * TILE_RENDER_WIDTH),
+            (int)(q.scale * TILE_RENDER_HEIGHT),
+        };
+
+        SDL_SetTextureColorMod(tex, q.color.r, q.color.g, q.color.b);
+        SDL_SetTextureAlphaMod(tex, q.color.a);
+
+        if (SDL_RenderCopy(renderer, tex, &src, &dest) < 0) {
+            fprintf(stderr, "SDL_RenderCopy Error: %s", SDL_GetError());
+            return false;
+        }
+    }
+
+#endif
+
+    return true;
+}
+
+
+bool draw_string(const std::string &str, Pair<int8_t> pos, const Style &s) {
+
     size_t str_pos{ 0 };
     Pair<int8_t> pos_offset(0, 0);
 
 
     while (str_pos < str.size()) {
-        
-        // Test for multi-character tokens
-        if      (str.compare(str_pos, 3, "!!!") == 0) {
-            t = Tile::PUNCT_EEEMARK;    
-            str_pos += 3;
-        } else if (str.compare(str_pos, 2, "!?") == 0) {
-            t = Tile::PUNCT_EQMARK;     
-            str_pos += 2;
-        } else if (str.compare(str_pos, 3, "...") == 0) {
-            t = Tile::PUNCT_ELLIPSIS;
-            str_pos += 3;
-        } else if (str.compare(str_pos, 2, "$$") == 0) {
-            t = Tile::PUNCT_MONEY_BOLD;
-            str_pos += 2;
-        } else if (str.compare(str_pos, 2, "//") == 0) {
-            t = Tile::PUNCT_DIVIDE;
-            str_pos += 2;
-        } else if (str.compare(str_pos, 2, "**") == 0) {
-            t = Tile::PUNCT_MULTIPLY;
-            str_pos += 2;
-        } else if (str[str_pos] == '\n') {
+
+        const TextToken token = read_token(str, str_pos);
+        str_pos += token.length;
+
+        if (token.newline) {
 
             // For handling new lines, we change our offset
             // to begin drawing the next characters on a lower line.
             pos_offset.first = 0;
             pos_offset.second++;
-            str_pos++;
             continue;
 
-        } else {
-            try {
-                t = char_to_tile.at(str[str_pos]);
-            } catch (const std::out_of_range& e) {
-                fprintf(stderr, "Error printing tile %u\n", (uint16_t)t);
-            }
-            str_pos++;
         }
-        
-        if (!draw_tile(t,
-            std::make_pair(pos.first + pos_offset.first, pos.second + pos_offset.second),s)
+
+        // characters with no tile of their own are drawn as FALLBACK_TILE
+        if (!draw_tile(token.tile,
+            std::make_pair(pos.first + pos_offset.first, pos.second + pos_offset.second), s)
         ) return false;
 
         pos_offset.first++;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+
+
+bool draw_map(const TileGrid &map, Pair<int16_t> origin,
+              const BitGrid &visible, const BitGrid &remembered,
+              const Style &lit, const Style &dim) {
+
+    for (int j = 0; j < SCREEN_TILES_HIGH; j++) {
+
+        const int y = origin.second + j;
+        if (y < 0 || y >= map.height()) continue;
+
+        const uint64_t *seen = remembered.row(y);
+        const uint64_t *lit_now = visible.row(y);
+
+        for (int i = 0; i < SCREEN_TILES_WIDE; i++) {
+
+            const int x = origin.first + i;
+            if (x < 0 || x >= map.width()) continue;
+
+            // skip unseen cells a whole word at a time where possible
+            if (seen[x / 64] == 0) {
+                i += 63 - (x % 64);
+                continue;
+            }
+            if (!((seen[x / 64] >> (x % 64)) & 1)) continue;
+
+            const bool in_view = (lit_now[x / 64] >> (x % 64)) & 1;
+
+            if (!draw_tile(map.at(x, y), std::make_pair(i, j), in_view ? lit : dim))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool draw_entities(const EntityStore &entities, const SpatialIndex &index, const StyleTable &styles,
+                   Pair<int16_t> origin, const Style &fallback) {
+
+    bool ok = true;
+
+    index.each_in(origin.first, origin.second,
+                  origin.first  + SCREEN_TILES_WIDE - 1,
+                  origin.second + SCREEN_TILES_HIGH - 1,
+                  [&](Entity e, Pair<int16_t> pos) {
+
+        if (!ok || !entities.glyphs.has(e)) return;
+        if (index.top(pos.first, pos.second) != e) return;
+
+        const Style &style = entities.styles.has(e) ? styles[entities.styles.get(e)] : fallback;
+
+        ok = draw_tile(
+            entities.glyphs.get(e),
+            std::make_pair(pos.first - origin.first, pos.second - origin.second),
+            style
+        );
+    });
+
+    return ok;
+}
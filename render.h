@@ -4,9 +4,14 @@
 #include <SDL2/SDL.h>
 #include <string>
 #include <memory>
+#include <vector>
+#include <array>
 
 #include "types.h"
+#include "grid.h"
 #include "style.h"
+#include "entity.h"
+#include "spatial.h"
 
 
 /* 
@@ -17,23 +22,45 @@
 typedef std::unordered_map<Tile, Pair<uint8_t>> TextureMapping;
 
 
+/*
+    The texture region of every tile, indexed by tile id.
+    Tiles without a region have an empty (zero sized) rectangle.
+*/
+typedef std::array<SDL_Rect, static_cast<size_t>(Tile::IDS_COUNT)> TileLegend;
+
+
 /*
     A map from tile id to texture region, so that we can render tiles.
+    Copies share the same texture, which is destroyed along with
+    the last of them. Without a renderer to upload the texture to,
+    its pixels are kept instead, for drawing on the CPU.
 */
 class TileMap {
 public:
 
     TileMap(const std::string &tex_file, const Pair<uint8_t> tile_size, const TextureMapping *);
 
+    /* Upload an already loaded surface; the surface still belongs to the caller */
+    TileMap(SDL_Surface *, const Pair<uint8_t> tile_size, const TextureMapping *);
+
+    /* Upload an already loaded surface whose regions are already known */
+    TileMap(SDL_Surface *, const TileLegend &);
+
     SDL_Rect region(Tile) const;
 
     SDL_Texture *atlas()  const;
 
+    /* The atlas as ARGB8888 pixels, or nullptr if it was uploaded */
+    const SDL_Surface *pixels() const;
+
 private:
 
-    std::unordered_map<Tile, SDL_Rect> legend;
+    void upload(SDL_Surface *);
+
+    TileLegend legend;
 
-    SDL_Texture *_atlas;
+    std::shared_ptr<SDL_Texture> _atlas;
+    std::shared_ptr<SDL_Surface> _pixels;
 
 };
 
@@ -44,6 +71,45 @@ private:
 typedef std::unordered_map<PaletteColor, const ColorRGBA> Palette;
 
 
+/*
+    The colors of a palette, indexed by palette color.
+*/
+typedef std::array<ColorRGBA, static_cast<size_t>(PaletteColor::COLOR_COUNT)> PaletteTable;
+
+
+class TintCache;
+
+
+/*
+    Somewhere other than the SDL renderer for frames to be drawn,
+    such as a terminal. With a backend in `render_config`, every
+    tile drawn (by `draw_tile`, `draw_string` and the rest) goes
+    to it instead, and so do the start and end of each frame.
+*/
+class RenderBackend {
+public:
+
+    virtual ~RenderBackend();
+
+    /* Start a frame, with nothing drawn in it yet */
+    virtual bool clear() = 0;
+
+    /* Draw `tile` over `dest` (in screen pixels), tinted `color` */
+    virtual bool draw(Tile tile, const SDL_Rect &dest, ColorRGBA color) = 0;
+
+    /* Show everything drawn since the last `clear` */
+    virtual bool present() = 0;
+
+    /*
+        Copy what has been drawn since the last `clear`, as
+        ARGB8888 rows with no padding. Returns false if the
+        backend has no pixels, or not that many of them.
+    */
+    virtual bool read(uint32_t *pixels, uint16_t width, uint16_t height) const;
+
+};
+
+
 /*
     The most basic elements needed to render a tile to the screen.
 */
@@ -61,6 +127,19 @@ struct RenderConfig {
     const TileMap   &tile_map();
     void             tile_map(TileMap *&);
     void             tile_map(TileMap *&&);
+
+    bool             has_tile_map() const;
+
+    /* Changes whenever the palette or tile map is replaced */
+    uint32_t         generation() const;
+
+    /* The cache of tinted tiles, or nullptr if tiles are always tinted as drawn */
+    TintCache       *tint_cache();
+    void             tint_cache(TintCache *&&);
+
+    /* Where frames are drawn, or nullptr if they are drawn by the SDL renderer */
+    RenderBackend   *backend();
+    void             backend(RenderBackend *&&);
     
     Pair<uint8_t>   render_scale;
 
@@ -68,15 +147,86 @@ struct RenderConfig {
 
     RenderConfig(Palette &,  Pair<uint8_t> render_scale);
     RenderConfig(Palette &&, Pair<uint8_t> render_scale);
+    ~RenderConfig();
     
 private:
 
     std::unique_ptr<Palette> _palette;
     std::unique_ptr<TileMap> _tile_map;
 
+    std::unique_ptr<TintCache>     _tint_cache;
+    std::unique_ptr<RenderBackend> _backend;
+
+    uint32_t _generation;
+
 };
 
 
+/* Start a new frame, and end it by showing what was drawn */
+bool begin_frame();
+bool end_frame();
+
+
 bool draw_tile(Tile, Pair<int8_t>, const Style&);
 
-bool draw_string(const std::string&, Pair<int8_t>, const Style&);
\ No newline at end of file
+bool draw_string(const std::string&, Pair<int8_t>, const Style&);
+
+
+
+/*
+    Tiles gathered up to be drawn all at once, at fractional
+    screen positions (in tiles) and each with its own tint.
+    With SDL 2.0.18 or later the whole batch is submitted as a
+    single `SDL_RenderGeometry` call; before that each tile is
+    still copied on its own.
+*/
+class TileBatch {
+public:
+
+    void add(Tile, float x, float y, ColorRGBA, float scale = 1.0f);
+
+    void   clear();
+    size_t size() const;
+
+private:
+
+    friend bool draw_tile_batch(TileBatch &);
+
+    struct Quad {
+        Tile      tile;
+        float     x, y, scale;
+        ColorRGBA color;
+    };
+
+    std::vector<Quad> quads;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // the geometry submitted, rebuilt on each draw
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int>        indices;
+#endif
+
+};
+
+bool draw_tile_batch(TileBatch &);
+
+
+/*
+    Draw the part of a map which fits on screen, with `origin`
+    being the map cell drawn in the top left corner. Cells which are
+    visible are drawn with `lit`, cells which are only remembered
+    are drawn with `dim`, and cells never seen are skipped entirely.
+*/
+bool draw_map(const TileGrid &, Pair<int16_t> origin,
+              const BitGrid &visible, const BitGrid &remembered,
+              const Style &lit, const Style &dim);
+
+
+/*
+    Draw the glyphs of the entities standing on screen, over
+    whatever map was drawn with the same `origin`. Only the
+    entity which entered each cell last is drawn, in its own
+    style if it has one, and in `fallback` otherwise.
+*/
+bool draw_entities(const EntityStore &, const SpatialIndex &, const StyleTable &,
+                   Pair<int16_t> origin, const Style &fallback);
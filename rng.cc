@@ -0,0 +1,36 @@
+
+#include <stdint.h>
+
+#include "rng.h"
+
+
+
+/* Implementation of Rng */
+
+
+uint64_t mix_seed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+Rng::Rng(uint64_t seed) : state{mix_seed(seed)} {
+    if (state == 0) state = 1; // xorshift never leaves zero
+}
+
+uint32_t Rng::next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+uint32_t Rng::range(uint32_t lo, uint32_t hi) {
+    if (hi <= lo) return lo;
+    return lo + (uint32_t)(((uint64_t)next() * (hi - lo)) >> 32);
+}
+
+bool Rng::chance(uint8_t percent) {
+    return range(0, 100) < percent;
+}
@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include <stdint.h>
+
+
+/*
+    A small, seedable random number generator (xorshift64*).
+    Unlike `rand()` it has no global state, so separate floors
+    can be generated on separate threads and still come out
+    the same for the same seed.
+*/
+class Rng {
+
+    uint64_t state;
+
+public:
+
+    explicit Rng(uint64_t seed);
+
+    uint32_t next();
+
+    /* A number in [lo, hi) */
+    uint32_t range(uint32_t lo, uint32_t hi);
+
+    /* True `percent` percent of the time */
+    bool chance(uint8_t percent);
+
+};
+
+
+/* Scramble a seed so that nearby seeds give unrelated streams (splitmix64) */
+uint64_t mix_seed(uint64_t);
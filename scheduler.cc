@@ -0,0 +1,274 @@
+
+#include <vector>
+#include <algorithm>
+
+#include "types.h"
+#include "grid.h"
+#include "entity.h"
+#include "scheduler.h"
+
+
+
+/* Implementation of TurnScheduler */
+
+
+constexpr uint32_t TurnScheduler::BUCKETS;
+constexpr uint32_t TurnScheduler::NONE;
+
+
+TurnScheduler::TurnScheduler()
+    : _now{0}, queued{0}, count{0} {
+
+    std::fill(heads, heads + BUCKETS, NONE);
+    std::fill(occupied, occupied + BUCKETS / 64, 0);
+}
+
+
+TurnScheduler::Slot *TurnScheduler::find(Entity e) {
+    if (e.index >= slots.size()) return nullptr;
+    Slot &s = slots[e.index];
+    return (s.state != State::ABSENT && s.generation == e.generation) ? &s : nullptr;
+}
+
+const TurnScheduler::Slot *TurnScheduler::find(Entity e) const {
+    if (e.index >= slots.size()) return nullptr;
+    const Slot &s = slots[e.index];
+    return (s.state != State::ABSENT && s.generation == e.generation) ? &s : nullptr;
+}
+
+
+int32_t TurnScheduler::current_energy(const Slot &s) const {
+    return s.energy + (int32_t)s.speed * (int32_t)(_now - s.since);
+}
+
+
+void TurnScheduler::link(uint32_t index) {
+    Slot &s = slots[index];
+    const uint32_t b = s.due & (BUCKETS - 1);
+
+    s.prev = NONE;
+    s.next = heads[b];
+    if (s.next != NONE) slots[s.next].prev = index;
+    heads[b] = index;
+
+    occupied[b / 64] |= (uint64_t)1 << (b % 64);
+    s.state = State::QUEUED;
+    queued++;
+}
+
+
+void TurnScheduler::unlink(uint32_t index) {
+    Slot &s = slots[index];
+    const uint32_t b = s.due & (BUCKETS - 1);
+
+    if (s.prev != NONE) slots[s.prev].next = s.next;
+    else                heads[b] = s.next;
+    if (s.next != NONE) slots[s.next].prev = s.prev;
+
+    if (heads[b] == NONE) occupied[b / 64] &= ~((uint64_t)1 << (b % 64));
+    queued--;
+}
+
+
+void TurnScheduler::schedule(uint32_t index) {
+    Slot &s = slots[index];
+    const int32_t needed = TURN_ENERGY - s.energy;
+
+    // anyone who can't act and isn't gaining energy waits outside the queue
+    if (needed > 0 && s.speed == 0) {
+        s.state = State::STALLED;
+        return;
+    }
+
+    s.due = _now + (needed <= 0 ? 0 : (uint32_t)((needed + s.speed - 1) / s.speed));
+    link(index);
+}
+
+
+void TurnScheduler::add(Entity e, uint16_t speed, int32_t energy) {
+    if (e.index >= slots.size()) slots.resize(e.index + 1, Slot{ 0, NONE, NONE, 0, 0, 0, 0, State::ABSENT });
+
+    // a slot still held by an earlier generation is taken over
+    Slot &s = slots[e.index];
+    if (s.state == State::QUEUED) unlink(e.index);
+    if (s.state != State::ABSENT) count--;
+
+    s.generation = e.generation;
+    s.speed      = speed;
+    s.energy     = energy;
+    s.since      = _now;
+
+    schedule(e.index);
+    count++;
+}
+
+
+void TurnScheduler::remove(Entity e) {
+    Slot *s = find(e);
+    if (!s) return;
+
+    if (s->state == State::QUEUED) unlink(e.index);
+    s->state = State::ABSENT;
+    count--;
+}
+
+
+bool TurnScheduler::contains(Entity e) const {
+    return find(e) != nullptr;
+}
+
+
+void TurnScheduler::set_speed(Entity e, uint16_t speed) {
+    Slot *s = find(e);
+    if (!s) return;
+
+    s->energy = current_energy(*s);
+    s->since  = _now;
+    s->speed  = speed;
+
+    // actors mid-turn are scheduled again once they spend energy
+    if (s->state == State::TAKEN) return;
+
+    if (s->state == State::QUEUED) unlink(e.index);
+    schedule(e.index);
+}
+
+
+void TurnScheduler::spend(Entity e, int32_t cost) {
+    Slot *s = find(e);
+    if (!s) return;
+
+    s->energy = current_energy(*s) - cost;
+    s->since  = _now;
+
+    if (s->state == State::QUEUED) unlink(e.index);
+    schedule(e.index);
+}
+
+
+int32_t TurnScheduler::energy(Entity e) const {
+    const Slot *s = find(e);
+    return s ? current_energy(*s) : 0;
+}
+
+
+uint32_t TurnScheduler::next_due(uint32_t from) const {
+
+    // the earliest turn seen, in case nobody acts within a lap of the ring
+    uint32_t earliest = NONE;
+
+    for (uint32_t d = 0; d < BUCKETS;) {
+
+        const uint32_t b = (from + d) & (BUCKETS - 1);
+        const uint64_t bits = occupied[b / 64] >> (b % 64);
+        if (!bits) {
+            d += 64 - b % 64;
+            continue;
+        }
+
+        d += __builtin_ctzll(bits);
+        if (d >= BUCKETS) break;
+
+        // buckets also hold turns whole laps of the ring away
+        const uint32_t t = from + d;
+        for (uint32_t i = heads[t & (BUCKETS - 1)]; i != NONE; i = slots[i].next) {
+            if (slots[i].due == t) return t;
+            earliest = std::min(earliest, slots[i].due);
+        }
+        d++;
+    }
+
+    return earliest;
+}
+
+
+bool TurnScheduler::next(std::vector<Entity> &out) {
+    out.clear();
+    if (queued == 0) return false;
+
+    _now = next_due(_now);
+
+    const uint32_t b = _now & (BUCKETS - 1);
+    uint32_t i = heads[b];
+    while (i != NONE) {
+        const uint32_t after = slots[i].next;
+        if (slots[i].due == _now) {
+            unlink(i);
+            slots[i].state = State::TAKEN;
+            out.push_back(Entity{ i, slots[i].generation });
+        }
+        i = after;
+    }
+
+    // the bucket is a stack, so put the earliest added first
+    std::reverse(out.begin(), out.end());
+    return true;
+}
+
+
+uint32_t TurnScheduler::now() const {
+    return _now;
+}
+
+
+size_t TurnScheduler::size() const {
+    return count;
+}
+
+
+
+/* Implementation of TurnBatcher */
+
+
+TurnBatcher::TurnBatcher(uint16_t width, uint16_t height)
+    : claims(width, height), stamps(width, height), stamp{0} { }
+
+
+void TurnBatcher::split(const std::vector<Entity> &actors,
+                        const ComponentArray<Pair<int16_t>> &positions,
+                        std::vector<std::vector<Entity>> &waves) {
+
+    waves.clear();
+    waves.resize(1);
+
+    // stamping the cells touched by each call means never clearing `claims`
+    if (++stamp == 0) {
+        stamps.fill(0);
+        stamp = 1;
+    }
+
+    for (Entity e : actors) {
+
+        if (!positions.has(e)) {
+            waves[0].push_back(e);
+            continue;
+        }
+
+        const Pair<int16_t> &p = positions.get(e);
+
+        // the waves already claiming any cell this actor could reach
+        uint64_t taken = 0;
+        for (int y = p.second - 1; y <= p.second + 1; y++)
+        for (int x = p.first  - 1; x <= p.first  + 1; x++)
+            if (claims.in_bounds(x, y) && stamps.at(x, y) == stamp) taken |= claims.at(x, y);
+
+        if (taken == ~(uint64_t)0) {
+            waves.push_back(std::vector<Entity>(1, e));
+            continue;
+        }
+
+        const uint8_t wave = __builtin_ctzll(~taken);
+        if (wave >= waves.size()) waves.resize(wave + 1);
+        waves[wave].push_back(e);
+
+        for (int y = p.second - 1; y <= p.second + 1; y++)
+        for (int x = p.first  - 1; x <= p.first  + 1; x++) {
+            if (!claims.in_bounds(x, y)) continue;
+            if (stamps.at(x, y) != stamp) {
+                stamps.at(x, y) = stamp;
+                claims.at(x, y) = 0;
+            }
+            claims.at(x, y) |= (uint64_t)1 << wave;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+#include "grid.h"
+#include "entity.h"
+
+
+// The energy an actor needs to take a turn
+static constexpr int32_t TURN_ENERGY = 100;
+
+
+
+/*
+    Energy based turn order. Every game tick each actor gains
+    energy equal to their speed, and takes a turn once they
+    have `TURN_ENERGY` of it; acting then spends some.
+
+    Rather than ticking every actor, each is filed under the
+    tick they will next act on in a calendar queue: a ring
+    of buckets, each an intrusive list, indexed by that tick.
+    Adding, removing and changing speed are all O(1), and a
+    bitmap of non-empty buckets finds the next turn quickly.
+*/
+class TurnScheduler {
+public:
+
+    TurnScheduler();
+
+    /* Schedule `e`, starting with `energy` */
+    void add(Entity e, uint16_t speed, int32_t energy = 0);
+
+    void remove(Entity e);
+    bool contains(Entity e) const;
+
+    /* Change how fast `e` gains energy, keeping what they have so far */
+    void set_speed(Entity e, uint16_t speed);
+
+    /* `e` took their turn, spending `cost` energy */
+    void spend(Entity e, int32_t cost);
+
+    /* The energy `e` has as of now */
+    int32_t energy(Entity e) const;
+
+    /*
+        Advance to the next tick anyone acts on, and store
+        everyone acting then in `out`. They are taken out of
+        the queue until they `spend` energy (or are removed).
+        Returns false if nobody is left to act.
+    */
+    bool next(std::vector<Entity> &out);
+
+    /* The current game tick */
+    uint32_t now() const;
+
+    /* The number of actors, waiting or taken */
+    size_t size() const;
+
+private:
+
+    // Must be a power of two, and a multiple of 64
+    static constexpr uint32_t BUCKETS = 1024u;
+
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    enum class State : uint8_t { ABSENT, QUEUED, TAKEN, STALLED };
+
+    struct Slot {
+        uint32_t due;          // the tick the actor next acts on
+        uint32_t next, prev;   // within the bucket of `due`
+        uint32_t since;        // the tick `energy` was last brought up to date
+        int32_t  energy;
+        uint32_t generation;
+        uint16_t speed;
+        State    state;
+    };
+
+    Slot *find(Entity e);
+    const Slot *find(Entity e) const;
+
+    int32_t current_energy(const Slot &) const;
+
+    /* Bring the energy of a slot up to date, and file it by its next turn */
+    void schedule(uint32_t index);
+
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+
+    /* The tick of the next turn after (or on) `from`, or NONE */
+    uint32_t next_due(uint32_t from) const;
+
+    std::vector<Slot> slots;   // indexed by entity index
+
+    uint32_t heads[BUCKETS];
+    uint64_t occupied[BUCKETS / 64];
+
+    uint32_t _now;
+    size_t   queued, count;
+
+};
+
+
+
+/*
+    Splits the actors taking a turn on the same tick into waves
+    whose turns can't conflict: actors in the same wave are
+    more than two cells apart, so no two of them can step onto
+    the same cell or into each other. The actors of a wave can
+    then act in any order (or in parallel), one wave at a time.
+*/
+class TurnBatcher {
+public:
+
+    TurnBatcher(uint16_t width, uint16_t height);
+
+    /*
+        Fill `waves` with `actors`. Actors without a position
+        can't conflict with anyone, and join the first wave.
+    */
+    void split(const std::vector<Entity> &actors,
+               const ComponentArray<Pair<int16_t>> &positions,
+               std::vector<std::vector<Entity>> &waves);
+
+private:
+
+    // The first 64 waves claiming each cell, one bit each; any
+    // actor who doesn't fit in them is given a wave of its own.
+    // Only valid where `stamps` matches the current call.
+    Grid<uint64_t> claims;
+    Grid<uint32_t> stamps;
+    uint32_t       stamp;
+
+};
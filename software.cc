@@ -0,0 +1,234 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "software.h"
+
+
+// The framebuffer is cleared to opaque black, like the SDL renderer
+static constexpr uint32_t CLEAR_PIXEL = 0xFF000000u;
+
+
+
+/* Tinting and blending */
+
+
+/* x / 255, rounded, for any x up to 255 * 255 */
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+
+/*
+    Tint ARGB8888 pixel `s` by `c` and blend it over `d`, as SDL
+    does with a color and alpha mod and SDL_BLENDMODE_BLEND.
+*/
+static inline uint32_t blend_pixel(uint32_t d, uint32_t s, ColorRGBA c) {
+
+    const uint32_t sa = div255((s >> 24)         * c.a);
+    const uint32_t sr = div255((s >> 16 & 0xFF) * c.r);
+    const uint32_t sg = div255((s >>  8 & 0xFF) * c.g);
+    const uint32_t sb = div255((s       & 0xFF) * c.b);
+
+    const uint32_t keep = 255 - sa;
+
+    return div255(sa * 255 + (d >> 24)         * keep) << 24
+         | div255(sr * sa  + (d >> 16 & 0xFF) * keep) << 16
+         | div255(sg * sa  + (d >>  8 & 0xFF) * keep) <<  8
+         | div255(sb * sa  + (d       & 0xFF) * keep);
+}
+
+
+#if defined(__SSE2__)
+
+static inline __m128i div255(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+
+/*
+    `blend_pixel` for two pixels at once, widened to 16 bits a
+    channel. Each product is at most 255 * 255, so every sum
+    still fits in 16 bits.
+*/
+static inline __m128i blend_pixels(__m128i d, __m128i s, __m128i mod) {
+
+    const __m128i full       = _mm_set1_epi16(255);
+    const __m128i alpha_lane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+    const __m128i tinted = div255(_mm_mullo_epi16(s, mod));
+
+    // each pixel's alpha across all of its channels
+    const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(tinted, 0xFF), 0xFF);
+
+    // the alpha channel itself is weighted by 255, not by alpha again
+    const __m128i weight = _mm_or_si128(_mm_andnot_si128(alpha_lane, a), _mm_and_si128(alpha_lane, full));
+
+    return div255(_mm_add_epi16(_mm_mullo_epi16(tinted, weight),
+                                _mm_mullo_epi16(d, _mm_sub_epi16(full, a))));
+}
+
+#endif
+
+
+/* Tint `n` pixels from `src` by `color`, and blend them over `dst` */
+static void blend_row(uint32_t *dst, const uint32_t *src, size_t n, ColorRGBA color) {
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+
+    // in the order of the channels of a pixel in memory: B, G, R, A
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mod  = _mm_set_epi16(color.a, color.r, color.g, color.b,
+                                       color.a, color.r, color.g, color.b);
+
+    for (; i + 4 <= n; i += 4) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        const __m128i lo = blend_pixels(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), mod);
+        const __m128i hi = blend_pixels(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), mod);
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+#endif
+
+    for (; i < n; i++) dst[i] = blend_pixel(dst[i], src[i], color);
+}
+
+
+
+/* Implementation of SoftwareBackend */
+
+
+SoftwareBackend::SoftwareBackend(uint16_t width, uint16_t height, SDL_Window *window, uint16_t fps)
+    : _width{width}, _height{height}
+    , frame((size_t)width * height, CLEAR_PIXEL)
+    , window{window}
+    , frame_ms{fps ? 1000u / fps : 0u}, last_present{0} {
+
+    surface = SDL_CreateRGBSurfaceWithFormatFrom(frame.data(), width, height, 32, width * 4,
+                                                 SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormatFrom Error: %s\n", SDL_GetError());
+    } else {
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    }
+}
+
+
+SoftwareBackend::~SoftwareBackend() {
+    SDL_FreeSurface(surface);
+}
+
+
+const uint32_t *SoftwareBackend::pixels() const { return frame.data(); }
+
+uint16_t SoftwareBackend::width()  const { return _width;  }
+uint16_t SoftwareBackend::height() const { return _height; }
+
+
+bool SoftwareBackend::clear() {
+    std::fill(frame.begin(), frame.end(), CLEAR_PIXEL);
+    return true;
+}
+
+
+bool SoftwareBackend::draw(Tile tile, const SDL_Rect &dest, ColorRGBA color) {
+
+    if (color.a == 0 || dest.w <= 0 || dest.h <= 0) return true;
+
+    const SDL_Surface *atlas = render_config.has_tile_map() ? render_config.tile_map().pixels() : nullptr;
+    if (atlas == nullptr) {
+        fprintf(stderr, "Software Error: the tile map has no pixels to draw from\n");
+        return false;
+    }
+
+    const SDL_Rect src = render_config.tile_map().region(tile);
+    if (src.w <= 0 || src.h <= 0) return true;
+
+    // only the part of `dest` which is on screen
+    const int x0 = std::max(dest.x, 0);
+    const int y0 = std::max(dest.y, 0);
+    const int x1 = std::min(dest.x + dest.w, (int)_width);
+    const int y1 = std::min(dest.y + dest.h, (int)_height);
+    if (x0 >= x1 || y0 >= y1) return true;
+
+    const size_t n = x1 - x0;
+    const bool scaled = dest.w != src.w;
+    if (scaled) row.resize(n);
+
+    for (int y = y0; y < y1; y++) {
+
+        const int sy = src.y + (y - dest.y) * src.h / dest.h;
+        const uint32_t *from = (const uint32_t *)((const uint8_t *)atlas->pixels + (size_t)sy * atlas->pitch);
+
+        // rows drawn at their own size come straight from the atlas
+        const uint32_t *pixels = from + src.x + (x0 - dest.x);
+
+        if (scaled) {
+            for (size_t i = 0; i < n; i++) row[i] = from[src.x + (x0 - dest.x + (int)i) * src.w / dest.w];
+            pixels = row.data();
+        }
+
+        blend_row(&frame[(size_t)y * _width + x0], pixels, n, color);
+    }
+
+    return true;
+}
+
+
+bool SoftwareBackend::present() {
+
+    if (window != nullptr && surface != nullptr) {
+
+        SDL_Surface *screen = SDL_GetWindowSurface(window);
+
+        if (screen == nullptr || SDL_BlitSurface(surface, nullptr, screen, nullptr) < 0
+                              || SDL_UpdateWindowSurface(window) < 0) {
+            fprintf(stderr, "SDL_UpdateWindowSurface Error: %s\n", SDL_GetError());
+            return false;
+        }
+    }
+
+    // stand in for vsync
+    const uint32_t now = SDL_GetTicks();
+    if (now - last_present < frame_ms) SDL_Delay(frame_ms - (now - last_present));
+    last_present = SDL_GetTicks();
+
+    return true;
+}
+
+
+bool SoftwareBackend::read(uint32_t *pixels, uint16_t width, uint16_t height) const {
+    if (width != _width || height != _height) return false;
+
+    memcpy(pixels, frame.data(), frame.size() * sizeof(uint32_t));
+    return true;
+}
+
+
+bool SoftwareBackend::save(const std::string &path) const {
+
+    if (surface == nullptr || SDL_SaveBMP(surface, path.c_str()) < 0) {
+        fprintf(stderr, "SDL_SaveBMP Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
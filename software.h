@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "render.h"
+
+
+/*
+    Draws frames on the CPU, into a plain ARGB8888 framebuffer,
+    with no SDL renderer involved at all. Tiles are copied out
+    of the pixels kept by the tile map (which keeps them only
+    when there is no renderer), scaled to the nearest pixel,
+    then tinted and alpha blended several pixels at a time.
+
+    Every frame comes out the same on every machine, so this
+    is also the way to take screenshots to compare against.
+    With a `window`, each frame is copied to its surface when
+    presented, at most `fps` times a second (0 for no limit);
+    without one, frames are only kept for `save` and `pixels`.
+*/
+class SoftwareBackend : public RenderBackend {
+public:
+
+    SoftwareBackend(uint16_t width, uint16_t height, SDL_Window *window = nullptr, uint16_t fps = 0);
+    ~SoftwareBackend();
+
+    SoftwareBackend(const SoftwareBackend &) = delete;
+    SoftwareBackend &operator=(const SoftwareBackend &) = delete;
+
+    bool clear() override;
+    bool draw(Tile tile, const SDL_Rect &dest, ColorRGBA color) override;
+    bool present() override;
+    bool read(uint32_t *pixels, uint16_t width, uint16_t height) const override;
+
+    /* Write the last frame drawn to a BMP file */
+    bool save(const std::string &path) const;
+
+    /* The frame, row after row with no padding */
+    const uint32_t *pixels() const;
+
+    uint16_t width()  const;
+    uint16_t height() const;
+
+private:
+
+    uint16_t _width, _height;
+
+    std::vector<uint32_t> frame;
+
+    // the frame, as a surface to blit and save
+    SDL_Surface *surface;
+
+    SDL_Window *window;
+    uint32_t    frame_ms, last_present;
+
+    // the source pixels of a scaled tile, one row at a time
+    std::vector<uint32_t> row;
+
+};
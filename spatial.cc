@@ -0,0 +1,159 @@
+
+#include <vector>
+
+#include "types.h"
+#include "world.h"
+#include "entity.h"
+#include "spatial.h"
+
+
+
+constexpr uint16_t SpatialIndex::BUCKET_SIZE;
+constexpr uint32_t SpatialIndex::NONE;
+
+
+SpatialIndex::SpatialIndex(uint16_t width, uint16_t height)
+    : _width{width}, _height{height}
+    , chunks_wide{(uint16_t)((width + CHUNK_SIZE - 1) / CHUNK_SIZE)}
+    , buckets_wide{(uint16_t)((width + BUCKET_SIZE - 1) / BUCKET_SIZE)}
+    , buckets_high{(uint16_t)((height + BUCKET_SIZE - 1) / BUCKET_SIZE)}
+    , pages((size_t)chunks_wide * ((height + CHUNK_SIZE - 1) / CHUNK_SIZE))
+    , buckets((size_t)buckets_wide * buckets_high, NONE) { }
+
+
+uint16_t SpatialIndex::width()  const { return _width;  }
+uint16_t SpatialIndex::height() const { return _height; }
+
+bool SpatialIndex::in_bounds(int x, int y) const {
+    return x >= 0 && y >= 0 && x < _width && y < _height;
+}
+
+
+uint32_t SpatialIndex::cell_head(int x, int y) const {
+    const std::vector<uint32_t> &page = pages[(y / CHUNK_SIZE) * chunks_wide + x / CHUNK_SIZE];
+    if (page.empty()) return NONE;
+    return page[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+}
+
+uint32_t &SpatialIndex::cell_head(int x, int y) {
+    std::vector<uint32_t> &page = pages[(y / CHUNK_SIZE) * chunks_wide + x / CHUNK_SIZE];
+    if (page.empty()) page.assign(CHUNK_TILES, NONE);
+    return page[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+}
+
+
+uint32_t SpatialIndex::bucket_head(int x, int y) const {
+    return buckets[(y / BUCKET_SIZE) * buckets_wide + x / BUCKET_SIZE];
+}
+
+uint32_t &SpatialIndex::bucket_head(int x, int y) {
+    return buckets[(y / BUCKET_SIZE) * buckets_wide + x / BUCKET_SIZE];
+}
+
+
+void SpatialIndex::link_cell(uint32_t index) {
+    Node &n = nodes[index];
+    uint32_t &head = cell_head(n.x, n.y);
+
+    n.cell_prev = NONE;
+    n.cell_next = head;
+    if (head != NONE) nodes[head].cell_prev = index;
+    head = index;
+}
+
+void SpatialIndex::unlink_cell(uint32_t index) {
+    Node &n = nodes[index];
+
+    if (n.cell_prev != NONE) nodes[n.cell_prev].cell_next = n.cell_next;
+    else                     cell_head(n.x, n.y) = n.cell_next;
+    if (n.cell_next != NONE) nodes[n.cell_next].cell_prev = n.cell_prev;
+}
+
+
+void SpatialIndex::link_bucket(uint32_t index) {
+    Node &n = nodes[index];
+    uint32_t &head = bucket_head(n.x, n.y);
+
+    n.bucket_prev = NONE;
+    n.bucket_next = head;
+    if (head != NONE) nodes[head].bucket_prev = index;
+    head = index;
+}
+
+void SpatialIndex::unlink_bucket(uint32_t index) {
+    Node &n = nodes[index];
+
+    if (n.bucket_prev != NONE) nodes[n.bucket_prev].bucket_next = n.bucket_next;
+    else                       bucket_head(n.x, n.y) = n.bucket_next;
+    if (n.bucket_next != NONE) nodes[n.bucket_next].bucket_prev = n.bucket_prev;
+}
+
+
+void SpatialIndex::insert(Entity e, Pair<int16_t> pos) {
+    if (!in_bounds(pos.first, pos.second)) return;
+
+    if (e.index >= nodes.size()) nodes.resize(e.index + 1, Node{ 0, 0, 0, NONE, NONE, NONE, NONE, false });
+
+    // a node still held by an earlier generation is taken over
+    Node &n = nodes[e.index];
+    if (n.present) {
+        unlink_cell(e.index);
+        unlink_bucket(e.index);
+    }
+
+    n.x = pos.first;
+    n.y = pos.second;
+    n.generation = e.generation;
+    n.present = true;
+
+    link_cell(e.index);
+    link_bucket(e.index);
+}
+
+
+void SpatialIndex::remove(Entity e) {
+    if (!contains(e)) return;
+
+    unlink_cell(e.index);
+    unlink_bucket(e.index);
+    nodes[e.index].present = false;
+}
+
+
+void SpatialIndex::move(Entity e, Pair<int16_t> to) {
+    if (!contains(e) || !in_bounds(to.first, to.second)) return;
+
+    Node &n = nodes[e.index];
+    if (n.x == to.first && n.y == to.second) return;
+
+    // most moves are a single step, which rarely leaves the bucket
+    const bool same_bucket = n.x / BUCKET_SIZE == to.first  / BUCKET_SIZE
+                          && n.y / BUCKET_SIZE == to.second / BUCKET_SIZE;
+
+    unlink_cell(e.index);
+    if (!same_bucket) unlink_bucket(e.index);
+
+    n.x = to.first;
+    n.y = to.second;
+
+    link_cell(e.index);
+    if (!same_bucket) link_bucket(e.index);
+}
+
+
+bool SpatialIndex::contains(Entity e) const {
+    return e.index < nodes.size() && nodes[e.index].present && nodes[e.index].generation == e.generation;
+}
+
+
+bool SpatialIndex::occupied(int x, int y) const {
+    return in_bounds(x, y) && cell_head(x, y) != NONE;
+}
+
+
+Entity SpatialIndex::top(int x, int y) const {
+    if (!in_bounds(x, y)) return NO_ENTITY;
+
+    const uint32_t i = cell_head(x, y);
+    return i == NONE ? NO_ENTITY : Entity{ i, nodes[i].generation };
+}
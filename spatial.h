@@ -0,0 +1,136 @@
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "types.h"
+#include "world.h"
+#include "entity.h"
+
+
+
+/*
+    Which entities are where, laid over the tile grid.
+
+    Every cell heads an intrusive list of the entities standing
+    on it, so asking what is at a cell never looks at anyone
+    else. The cell lists are kept in pages one chunk in size,
+    only allocated once something enters that chunk, so large
+    and mostly empty worlds cost little.
+
+    Entities are also linked into coarse buckets of
+    `BUCKET_SIZE` square cells, so range queries only walk
+    the buckets overlapping the range.
+*/
+class SpatialIndex {
+public:
+
+    static constexpr uint16_t BUCKET_SIZE = 8u;
+
+    SpatialIndex(uint16_t width, uint16_t height);
+
+    uint16_t width()  const;
+    uint16_t height() const;
+
+    bool in_bounds(int x, int y) const;
+
+    void insert(Entity, Pair<int16_t> pos);
+    void remove(Entity);
+    void move(Entity, Pair<int16_t> to);
+
+    bool contains(Entity) const;
+
+    /* Whether anything stands at (x, y) */
+    bool occupied(int x, int y) const;
+
+    /* The entity which entered (x, y) last, or NO_ENTITY */
+    Entity top(int x, int y) const;
+
+    /* Call `f(entity)` for everything at (x, y), most recent first */
+    template <class F>
+    void each_at(int x, int y, F f) const;
+
+    /* Call `f(entity, position)` for everything in the rectangle [x0, x1] by [y0, y1] */
+    template <class F>
+    void each_in(int x0, int y0, int x1, int y1, F f) const;
+
+    /* Call `f(entity, position)` for everything within `r` steps (in 8 directions) of (x, y) */
+    template <class F>
+    void each_within(int x, int y, int r, F f) const;
+
+private:
+
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    struct Node {
+        int16_t  x, y;
+        uint32_t generation;
+        uint32_t cell_next,   cell_prev;
+        uint32_t bucket_next, bucket_prev;
+        bool     present;
+    };
+
+    uint32_t  cell_head(int x, int y) const;
+    uint32_t &cell_head(int x, int y);
+
+    uint32_t  bucket_head(int x, int y) const;
+    uint32_t &bucket_head(int x, int y);
+
+    void link_cell(uint32_t index);
+    void unlink_cell(uint32_t index);
+
+    void link_bucket(uint32_t index);
+    void unlink_bucket(uint32_t index);
+
+    uint16_t _width, _height;
+    uint16_t chunks_wide, buckets_wide, buckets_high;
+
+    std::vector<Node> nodes;   // indexed by entity index
+
+    // the first entity in each cell, by chunk; empty until needed
+    std::vector<std::vector<uint32_t>> pages;
+
+    std::vector<uint32_t> buckets;
+
+};
+
+
+
+template <class F>
+void SpatialIndex::each_at(int x, int y, F f) const {
+    if (!in_bounds(x, y)) return;
+    for (uint32_t i = cell_head(x, y); i != NONE; i = nodes[i].cell_next)
+        f(Entity{ i, nodes[i].generation });
+}
+
+
+template <class F>
+void SpatialIndex::each_in(int x0, int y0, int x1, int y1, F f) const {
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, _width  - 1);
+    y1 = std::min(y1, _height - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    for (int by = y0 / BUCKET_SIZE; by <= y1 / BUCKET_SIZE; by++)
+    for (int bx = x0 / BUCKET_SIZE; bx <= x1 / BUCKET_SIZE; bx++) {
+
+        // buckets entirely inside the range need no checks
+        const bool inside = bx * BUCKET_SIZE >= x0 && (bx + 1) * BUCKET_SIZE - 1 <= x1
+                         && by * BUCKET_SIZE >= y0 && (by + 1) * BUCKET_SIZE - 1 <= y1;
+
+        for (uint32_t i = buckets[by * buckets_wide + bx]; i != NONE; i = nodes[i].bucket_next) {
+            const Node &n = nodes[i];
+            if (inside || (n.x >= x0 && n.x <= x1 && n.y >= y0 && n.y <= y1))
+                f(Entity{ i, n.generation }, std::make_pair(n.x, n.y));
+        }
+    }
+}
+
+
+template <class F>
+void SpatialIndex::each_within(int x, int y, int r, F f) const {
+    each_in(x - r, y - r, x + r, y + r, f);
+}
@@ -4,6 +4,7 @@
 #include "types.h"
 #include "mappings.h"
 #include "render.h"
+#include "state.h"
 
 /*
     The declarations for global state used in the game.
@@ -22,7 +23,7 @@ SDL_Renderer *renderer;
 
 
 /* Primary render configuration */
-RenderConfig render_config = RenderConfig(
+RenderConfig render_config(
     *Mappings::default_palette(),
     { 16, 16 }
 );
@@ -41,13 +42,16 @@ uint32_t get_ticks_delta() { return ticks_delta; }
 
 
 
+/* Where the ticks come from */
+static TickSource tick_source = SDL_GetTicks;
+
 /* Whether the tick counters have been initialized yet */
 static bool initialized_ticks = false;
 
 /* Initialize, for the first time, the tick counters. */
 static void init_tick_counts() {
     
-    ticks_total = SDL_GetTicks();
+    ticks_total = tick_source();
     ticks_delta = ticks_total;
     initialized_ticks = true; // prevent another initialization later
 
@@ -63,9 +67,15 @@ void update_tick_counts() {
     }
 
     // update ticks variables
-    uint32_t new_ticks_total = SDL_GetTicks();
+    uint32_t new_ticks_total = tick_source();
     ticks_delta = new_ticks_total - ticks_total;
     ticks_total = new_ticks_total;
 
 }
 
+
+
+void set_tick_source(TickSource source) {
+    tick_source = source ? source : SDL_GetTicks;
+    initialized_ticks = false;
+}
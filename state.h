@@ -39,6 +39,13 @@ static constexpr const char *DEFAULT_TEXTURE_BMP = "./assets/textures/tilemap.bm
 // The default tile size used for the above two properties
 static constexpr Pair<uint8_t> DEFAULT_TILE_SIZE = { 16u, 16u };
 
+// The theme giving the default texture, tile mapping and palette.
+static constexpr const char *DEFAULT_THEME = "./assets/themes/default.theme";
+
+// The baked form of the default textures, mappings and palette,
+// rebuilt from them whenever any of them change.
+static constexpr const char *DEFAULT_ASSET_PACK = "./assets/default.pack";
+
 
 
 /* Primary render configuration */
@@ -63,5 +70,15 @@ uint32_t get_ticks_delta();
 /* update the ticks for this frame */
 void update_tick_counts();
 
+/* A clock to count ticks with, in milliseconds */
+typedef uint32_t (*TickSource)();
+
+/*
+    Count ticks with `source` rather than `SDL_GetTicks`, so
+    that frames can be drawn over exactly as they were, and
+    start counting over. A null `source` goes back to SDL.
+*/
+void set_tick_source(TickSource source);
+
 
 
@@ -39,6 +39,8 @@ void Color::invalidate_dynamic() {
     }
 }
 
+bool Color::stable() const { return cache_type == CachingType::STATIC; }
+
 
 std::vector<Offset*> Offset::dynamic_offsets;
 
@@ -111,6 +113,10 @@ const Pair<float> Style::scale() const {
     return s->value();
 }
 
+bool Style::stable_color() const {
+    return c->stable();
+}
+
 
 /*
     The most basic kinds of values; those which are static.
@@ -188,6 +194,8 @@ Color *color_from_palette(PaletteColor pc) {
 
         void invalidate() { valid = false; }
 
+        bool stable() const { return true; }
+
         const ColorRGBA value() {
             if (!valid) {
                 color = render_config.palette().at(pc);
@@ -389,8 +397,11 @@ static Color *combine_colors(Color *c1, Color *c2) {
             valid = false;
         }
 
+        bool stable() const { return c1->stable() && c2->stable(); }
+
         const ColorRGBA value() {
-            if (!valid) {
+            // a part which changes per tile is never cached, so neither is the whole
+            if (!valid || cache_type == CachingType::DYNAMIC_NOCACHE) {
                 color = color_multiply(c1->value(), c2->value());
                 valid = true;
             }
@@ -436,7 +447,7 @@ static Offset *combine_offsets(Offset *o1, Offset *o2) {
         }
 
         const Pair<int16_t> value() {
-            if (!valid) {
+            if (!valid || cache_type == CachingType::DYNAMIC_NOCACHE) {
                 offset = offset_add(o1->value(), o2->value());
                 valid = true;
             }
@@ -482,7 +493,7 @@ static Scale *combine_scales(Scale *s1, Scale *s2) {
         }
 
         const Pair<float> value() {
-            if (!valid) {
+            if (!valid || cache_type == CachingType::DYNAMIC_NOCACHE) {
                 scale = scale_multiply(s1->value(), s2->value());
                 valid = true;
             }
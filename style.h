@@ -36,6 +36,12 @@ public:
     
     virtual void invalidate() = 0;
 
+    /*
+        Whether the color only ever changes along with the
+        palette, so that tiles drawn in it are worth caching.
+    */
+    virtual bool stable() const;
+
     const CachingType cache_type;
     
 };
@@ -167,6 +173,8 @@ public:
     const Pair<int16_t> offset() const;
     const Pair<float>   scale()  const;
 
+    bool stable_color() const;
+
     Style compose(const Style&);
 
     Style compose(Color *);
@@ -0,0 +1,197 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "terminal.h"
+
+
+static constexpr size_t TILE_COUNT = static_cast<size_t>(Tile::IDS_COUNT);
+
+
+/*
+    The character for each tile, in the order of the Tile enum.
+    Bold letters are capitals, as in `draw_string`, and only
+    characters a single column wide are used, so the cells
+    always line up.
+*/
+static const char *const TILE_GLYPHS[] = {
+    "█", // PLAIN_FILL
+
+    // N, S, E, W, NW, NE, SW, SE, NS, WE, NSW, NSE, SWE, NWE, NSWE, NONE
+    "╵", "╷", "╶", "╴", "┘", "└", "┐", "┌",
+    "│", "─", "┤", "├", "┬", "┴", "┼", "□",
+
+    "╹", "╻", "╺", "╸", "┛", "┗", "┓", "┏",
+    "┃", "━", "┫", "┣", "┳", "┻", "╋", "■",
+
+    "╵", "╷", "╶", "╴", "╯", "╰", "╮", "╭",
+    "│", "─", "┤", "├", "┬", "┴", "┼", "□",
+
+    // there are no heavy rounded corners, so the bold ones are only heavy
+    "╹", "╻", "╺", "╸", "┛", "┗", "┓", "┏",
+    "┃", "━", "┫", "┣", "┳", "┻", "╋", "■",
+
+    " ", ".", ",", "“", "”", "!", "?", "…", ":", "(", ")",
+    "‼", "⁉", "+", "-", "÷", "*", "<", ">", "/", "×", "$", "$",
+
+    "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+    "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+
+    "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M",
+    "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z",
+
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+
+    "▸", "▹", // MENU_CURSOR_SELECTED, MENU_CURSOR_UNSELECTED
+};
+
+static_assert(sizeof(TILE_GLYPHS) / sizeof(TILE_GLYPHS[0]) == TILE_COUNT,
+              "every tile needs a glyph, in the order of the Tile enum");
+
+
+
+/* Implementation of TerminalBackend */
+
+
+bool TerminalBackend::Cell::operator==(const Cell &o) const {
+    return tile == o.tile && color.r == o.color.r && color.g == o.color.g && color.b == o.color.b;
+}
+
+bool TerminalBackend::Cell::operator!=(const Cell &o) const { return !(*this == o); }
+
+
+// a blank cell, which is what the terminal shows once cleared
+static const Tile BLANK = Tile::PUNCT_SPACE;
+
+
+TerminalBackend::TerminalBackend(FILE *out, uint16_t cols, uint16_t rows, uint16_t fps)
+    : out{out}, cols{cols}, rows{rows}
+    , frame_ms{fps ? 1000u / fps : 0u}, last_present{0}
+    , cells((size_t)cols * rows, Cell{ BLANK, ColorRGB() })
+    , shown((size_t)cols * rows, Cell{ BLANK, ColorRGB() })
+    , cursor_x{-1}, cursor_y{-1}
+    , pen_set{false}, started{false} { }
+
+
+TerminalBackend::~TerminalBackend() {
+    if (!started) return;
+
+    // leave the prompt below the grid, looking as it did before
+    buffer.clear();
+    move_to(0, rows - 1);
+    buffer += "\x1b[0m\r\n\x1b[?25h";
+    fwrite(buffer.data(), 1, buffer.size(), out);
+    fflush(out);
+}
+
+
+const char *TerminalBackend::glyph(Tile t) {
+    return static_cast<size_t>(t) < TILE_COUNT ? TILE_GLYPHS[static_cast<size_t>(t)] : "?";
+}
+
+
+bool TerminalBackend::clear() {
+    for (Cell &c : cells) c = Cell{ BLANK, ColorRGB() };
+    return true;
+}
+
+
+bool TerminalBackend::draw(Tile tile, const SDL_Rect &dest, ColorRGBA color) {
+
+    if (color.a == 0) return true;
+
+    // whichever cell the middle of the tile lands in
+    const int x = (dest.x + dest.w / 2) / TILE_RENDER_WIDTH;
+    const int y = (dest.y + dest.h / 2) / TILE_RENDER_HEIGHT;
+    if (dest.x + dest.w / 2 < 0 || dest.y + dest.h / 2 < 0 || x >= cols || y >= rows) return true;
+
+    // there is nothing beneath to blend with, so translucent tiles are just darker
+    const ColorRGB rgb(color.r * color.a / 255, color.g * color.a / 255, color.b * color.a / 255);
+
+    // blanks look the same in any color, and should compare the same too
+    cells[(size_t)y * cols + x] = Cell{ tile, tile == BLANK ? ColorRGB() : rgb };
+    return true;
+}
+
+
+void TerminalBackend::move_to(uint16_t x, uint16_t y) {
+
+    if (cursor_y == y && cursor_x == x) return;
+
+    char seq[24];
+
+    if (cursor_y == y && cursor_x >= 0 && cursor_x < x) {
+        snprintf(seq, sizeof(seq), "\x1b[%uC", (unsigned)(x - cursor_x));
+    } else if (x == 0 && cursor_y >= 0 && cursor_y + 1 == y) {
+        snprintf(seq, sizeof(seq), "\r\n");
+    } else {
+        snprintf(seq, sizeof(seq), "\x1b[%u;%uH", (unsigned)y + 1, (unsigned)x + 1);
+    }
+
+    buffer += seq;
+    cursor_x = x;
+    cursor_y = y;
+}
+
+
+void TerminalBackend::set_color(const ColorRGB &c) {
+
+    if (pen_set && pen.r == c.r && pen.g == c.g && pen.b == c.b) return;
+
+    char seq[24];
+    snprintf(seq, sizeof(seq), "\x1b[38;2;%u;%u;%um", (unsigned)c.r, (unsigned)c.g, (unsigned)c.b);
+
+    buffer += seq;
+    pen     = c;
+    pen_set = true;
+}
+
+
+bool TerminalBackend::present() {
+
+    buffer.clear();
+
+    if (!started) {
+        // hide the cursor and start from a blank screen, which `shown` already matches
+        buffer += "\x1b[?25l\x1b[0m\x1b[H\x1b[2J";
+        cursor_x = cursor_y = 0;
+        started  = true;
+    }
+
+    for (uint16_t y = 0; y < rows; y++)
+    for (uint16_t x = 0; x < cols; x++) {
+
+        const size_t i = (size_t)y * cols + x;
+        if (cells[i] == shown[i]) continue;
+
+        move_to(x, y);
+        if (cells[i].tile != BLANK) set_color(cells[i].color);
+        buffer += glyph(cells[i].tile);
+
+        // terminals differ on where the cursor goes after the last column
+        if (x + 1 < cols) cursor_x = x + 1; else cursor_x = cursor_y = -1;
+
+        shown[i] = cells[i];
+    }
+
+    if (!buffer.empty()) {
+        if (fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size() || fflush(out) != 0) {
+            fprintf(stderr, "Terminal Error: %s\n", strerror(errno));
+            return false;
+        }
+    }
+
+    // stand in for vsync
+    const uint32_t now = SDL_GetTicks();
+    if (now - last_present < frame_ms) SDL_Delay(frame_ms - (now - last_present));
+    last_present = SDL_GetTicks();
+
+    return true;
+}
@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "render.h"
+
+
+/*
+    Draws frames as text, for watching games which have no
+    window (over SSH, say). Each tile becomes one character,
+    mostly from the box drawing block, in 24-bit color, and
+    the grid is `cols` by `rows` tiles.
+
+    Each frame only writes out the cells which changed since
+    the last one, moving the cursor as little as it can, so a
+    mostly still screen costs next to nothing to keep up to date.
+    There is no vsync to wait on, so frames are held back to
+    at most `fps` a second instead.
+*/
+class TerminalBackend : public RenderBackend {
+public:
+
+    TerminalBackend(FILE *out, uint16_t cols, uint16_t rows, uint16_t fps = 30);
+    ~TerminalBackend();
+
+    TerminalBackend(const TerminalBackend &) = delete;
+    TerminalBackend &operator=(const TerminalBackend &) = delete;
+
+    bool clear() override;
+    bool draw(Tile tile, const SDL_Rect &dest, ColorRGBA color) override;
+    bool present() override;
+
+    /* The character a tile is drawn as, in UTF-8 */
+    static const char *glyph(Tile);
+
+private:
+
+    struct Cell {
+        Tile     tile;
+        ColorRGB color;
+
+        bool operator==(const Cell &) const;
+        bool operator!=(const Cell &) const;
+    };
+
+    void move_to(uint16_t x, uint16_t y);
+    void set_color(const ColorRGB &);
+
+    FILE    *out;
+    uint16_t cols, rows;
+    uint32_t frame_ms, last_present;
+
+    // what is being drawn, and what the terminal is showing
+    std::vector<Cell> cells, shown;
+
+    // everything written for one frame, sent all at once
+    std::string buffer;
+
+    // where the cursor is, with -1 if the terminal could have put it anywhere
+    int32_t  cursor_x, cursor_y;
+    ColorRGB pen;
+    bool     pen_set;
+    bool     started;
+
+};
@@ -0,0 +1,551 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "types.h"
+#include "state.h"
+#include "style.h"
+#include "render.h"
+#include "text.h"
+
+
+// The number of layouts kept, in case the same text is laid out again
+static constexpr size_t TEXT_CACHE_SIZE = 256;
+
+
+
+/* Reading text */
+
+
+/* A character and the tile drawn for it */
+struct Glyph {
+    uint32_t codepoint;
+    Tile     tile;
+};
+
+static constexpr uint32_t NO_CODEPOINT = UINT32_MAX;
+
+
+/*
+    Every character with a tile of its own. Characters from
+    the terminal's table (see terminal.cc) read back as the
+    tiles they are shown for, the first listed winning where a
+    character stands for tiles of more than one family.
+*/
+static constexpr Glyph GLYPHS[] = {
+    { 'a', Tile::ALPHANUM_A }, { 'b', Tile::ALPHANUM_B }, { 'c', Tile::ALPHANUM_C },
+    { 'd', Tile::ALPHANUM_D }, { 'e', Tile::ALPHANUM_E }, { 'f', Tile::ALPHANUM_F },
+    { 'g', Tile::ALPHANUM_G }, { 'h', Tile::ALPHANUM_H }, { 'i', Tile::ALPHANUM_I },
+    { 'j', Tile::ALPHANUM_J }, { 'k', Tile::ALPHANUM_K }, { 'l', Tile::ALPHANUM_L },
+    { 'm', Tile::ALPHANUM_M }, { 'n', Tile::ALPHANUM_N }, { 'o', Tile::ALPHANUM_O },
+    { 'p', Tile::ALPHANUM_P }, { 'q', Tile::ALPHANUM_Q }, { 'r', Tile::ALPHANUM_R },
+    { 's', Tile::ALPHANUM_S }, { 't', Tile::ALPHANUM_T }, { 'u', Tile::ALPHANUM_U },
+    { 'v', Tile::ALPHANUM_V }, { 'w', Tile::ALPHANUM_W }, { 'x', Tile::ALPHANUM_X },
+    { 'y', Tile::ALPHANUM_Y }, { 'z', Tile::ALPHANUM_Z },
+
+    { 'A', Tile::ALPHANUM_A_BOLD }, { 'B', Tile::ALPHANUM_B_BOLD }, { 'C', Tile::ALPHANUM_C_BOLD },
+    { 'D', Tile::ALPHANUM_D_BOLD }, { 'E', Tile::ALPHANUM_E_BOLD }, { 'F', Tile::ALPHANUM_F_BOLD },
+    { 'G', Tile::ALPHANUM_G_BOLD }, { 'H', Tile::ALPHANUM_H_BOLD }, { 'I', Tile::ALPHANUM_I_BOLD },
+    { 'J', Tile::ALPHANUM_J_BOLD }, { 'K', Tile::ALPHANUM_K_BOLD }, { 'L', Tile::ALPHANUM_L_BOLD },
+    { 'M', Tile::ALPHANUM_M_BOLD }, { 'N', Tile::ALPHANUM_N_BOLD }, { 'O', Tile::ALPHANUM_O_BOLD },
+    { 'P', Tile::ALPHANUM_P_BOLD }, { 'Q', Tile::ALPHANUM_Q_BOLD }, { 'R', Tile::ALPHANUM_R_BOLD },
+    { 'S', Tile::ALPHANUM_S_BOLD }, { 'T', Tile::ALPHANUM_T_BOLD }, { 'U', Tile::ALPHANUM_U_BOLD },
+    { 'V', Tile::ALPHANUM_V_BOLD }, { 'W', Tile::ALPHANUM_W_BOLD }, { 'X', Tile::ALPHANUM_X_BOLD },
+    { 'Y', Tile::ALPHANUM_Y_BOLD }, { 'Z', Tile::ALPHANUM_Z_BOLD },
+
+    { '0', Tile::ALPHANUM_0 }, { '1', Tile::ALPHANUM_1 }, { '2', Tile::ALPHANUM_2 },
+    { '3', Tile::ALPHANUM_3 }, { '4', Tile::ALPHANUM_4 }, { '5', Tile::ALPHANUM_5 },
+    { '6', Tile::ALPHANUM_6 }, { '7', Tile::ALPHANUM_7 }, { '8', Tile::ALPHANUM_8 },
+    { '9', Tile::ALPHANUM_9 },
+
+    { ' ',  Tile::PUNCT_SPACE     },
+    { '.',  Tile::PUNCT_FSTOP     },
+    { ',',  Tile::PUNCT_COMMA     },
+    { '`',  Tile::PUNCT_LQUOT     },
+    { '\'', Tile::PUNCT_RQUOT     },
+    { '!',  Tile::PUNCT_EMARK     },
+    { '?',  Tile::PUNCT_QMARK     },
+    { ':',  Tile::PUNCT_COLON     },
+    { '(',  Tile::PUNCT_LPAREN    },
+    { ')',  Tile::PUNCT_RPAREN    },
+    { '+',  Tile::PUNCT_PLUS      },
+    { '-',  Tile::PUNCT_MINUS     },
+    { '*',  Tile::PUNCT_MULTSMALL },
+    { '<',  Tile::PUNCT_LTSIGN    },
+    { '>',  Tile::PUNCT_GTSIGN    },
+    { '/',  Tile::PUNCT_SOLIDUS   },
+    { '$',  Tile::PUNCT_MONEY     },
+
+    { 0x201C, Tile::PUNCT_LQUOT     }, // “
+    { 0x201D, Tile::PUNCT_RQUOT     }, // ”
+    { 0x2018, Tile::PUNCT_LQUOT     }, // ‘
+    { 0x2019, Tile::PUNCT_RQUOT     }, // ’
+    { 0x2026, Tile::PUNCT_ELLIPSIS  }, // …
+    { 0x203C, Tile::PUNCT_EEEMARK   }, // ‼
+    { 0x2049, Tile::PUNCT_EQMARK    }, // ⁉
+    { 0x2212, Tile::PUNCT_MINUS     }, // −
+    { 0x00F7, Tile::PUNCT_DIVIDE    }, // ÷
+    { 0x2716, Tile::PUNCT_MULTIPLY  }, // ✖
+    { 0x00D7, Tile::PUNCT_MULTSMALL }, // ×
+
+    { 0x2588, Tile::PLAIN_FILL             }, // █
+    { 0x25B8, Tile::MENU_CURSOR_SELECTED   }, // ▸
+    { 0x25B6, Tile::MENU_CURSOR_SELECTED   }, // ▶
+    { 0x25B9, Tile::MENU_CURSOR_UNSELECTED }, // ▹
+    { 0x25B7, Tile::MENU_CURSOR_UNSELECTED }, // ▷
+
+    // ╵ ╷ ╶ ╴ ┘ └ ┐ ┌ │ ─ ┤ ├ ┬ ┴ ┼ □
+    { 0x2575, Tile::BORDER_N    }, { 0x2577, Tile::BORDER_S    }, { 0x2576, Tile::BORDER_E    }, { 0x2574, Tile::BORDER_W    },
+    { 0x2518, Tile::BORDER_NW   }, { 0x2514, Tile::BORDER_NE   }, { 0x2510, Tile::BORDER_SW   }, { 0x250C, Tile::BORDER_SE   },
+    { 0x2502, Tile::BORDER_NS   }, { 0x2500, Tile::BORDER_WE   }, { 0x2524, Tile::BORDER_NSW  }, { 0x251C, Tile::BORDER_NSE  },
+    { 0x252C, Tile::BORDER_SWE  }, { 0x2534, Tile::BORDER_NWE  }, { 0x253C, Tile::BORDER_NSWE }, { 0x25A1, Tile::BORDER_NONE },
+
+    // ╹ ╻ ╺ ╸ ┛ ┗ ┓ ┏ ┃ ━ ┫ ┣ ┳ ┻ ╋ ■
+    { 0x2579, Tile::BORDER_N_BOLD    }, { 0x257B, Tile::BORDER_S_BOLD    }, { 0x257A, Tile::BORDER_E_BOLD    }, { 0x2578, Tile::BORDER_W_BOLD    },
+    { 0x251B, Tile::BORDER_NW_BOLD   }, { 0x2517, Tile::BORDER_NE_BOLD   }, { 0x2513, Tile::BORDER_SW_BOLD   }, { 0x250F, Tile::BORDER_SE_BOLD   },
+    { 0x2503, Tile::BORDER_NS_BOLD   }, { 0x2501, Tile::BORDER_WE_BOLD   }, { 0x252B, Tile::BORDER_NSW_BOLD  }, { 0x2523, Tile::BORDER_NSE_BOLD  },
+    { 0x2533, Tile::BORDER_SWE_BOLD  }, { 0x253B, Tile::BORDER_NWE_BOLD  }, { 0x254B, Tile::BORDER_NSWE_BOLD }, { 0x25A0, Tile::BORDER_NONE_BOLD },
+
+    // ╯ ╰ ╮ ╭
+    { 0x256F, Tile::BORDER_ROUND_NW }, { 0x2570, Tile::BORDER_ROUND_NE }, { 0x256E, Tile::BORDER_ROUND_SW }, { 0x256D, Tile::BORDER_ROUND_SE },
+};
+
+static constexpr size_t GLYPH_COUNT = sizeof(GLYPHS) / sizeof(GLYPHS[0]);
+
+
+/*
+    Characters are looked up without searching, in tables filled
+    in by the compiler from `GLYPHS`: ASCII by its own value,
+    and anything else by a multiplicative hash which puts every
+    glyph in a slot of its own. Adding a glyph which collides
+    fails to compile; search for a new multiplier (any odd one
+    will do) until it doesn't.
+*/
+static constexpr uint32_t GLYPH_HASH_MULTIPLIER = 0x8968B583u;
+static constexpr uint32_t GLYPH_HASH_BITS       = 7;
+static constexpr size_t   GLYPH_HASH_SLOTS      = 1u << GLYPH_HASH_BITS;
+
+static constexpr uint32_t glyph_hash(uint32_t codepoint) {
+    return (uint32_t)(codepoint * GLYPH_HASH_MULTIPLIER) >> (32 - GLYPH_HASH_BITS);
+}
+
+
+/* The first glyph from `i` on for which `matches` holds, or an empty one with the fallback tile */
+template <typename Match>
+static constexpr Glyph find_glyph(Match matches, size_t i = 0) {
+    return i == GLYPH_COUNT    ? Glyph{ NO_CODEPOINT, FALLBACK_TILE }
+         : matches(GLYPHS[i])  ? GLYPHS[i]
+         : find_glyph(matches, i + 1);
+}
+
+struct IsCodepoint {
+    uint32_t c;
+    constexpr bool operator()(const Glyph &g) const { return g.codepoint == c; }
+};
+
+struct InSlot {
+    uint32_t slot;
+    constexpr bool operator()(const Glyph &g) const { return g.codepoint >= 0x80 && glyph_hash(g.codepoint) == slot; }
+};
+
+
+/* Whether any glyph from `j` on shares its slot with glyph `i` (ASCII has no slots) */
+static constexpr bool slot_shared(size_t i, size_t j) {
+    return j == GLYPH_COUNT ? false
+         : (GLYPHS[j].codepoint >= 0x80 && GLYPHS[j].codepoint != GLYPHS[i].codepoint
+            && glyph_hash(GLYPHS[j].codepoint) == glyph_hash(GLYPHS[i].codepoint)) || slot_shared(i, j + 1);
+}
+
+/* Whether every glyph outside ASCII has a slot of its own */
+static constexpr bool glyphs_hash_perfectly(size_t i = 0) {
+    return i == GLYPH_COUNT ? true
+         : (GLYPHS[i].codepoint < 0x80 || !slot_shared(i, i + 1)) && glyphs_hash_perfectly(i + 1);
+}
+
+static_assert(glyphs_hash_perfectly(), "two glyphs share a slot: change GLYPH_HASH_MULTIPLIER");
+
+
+template <size_t... I> struct Indices { };
+
+template <size_t N, size_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> { };
+template <size_t... I>           struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+template <size_t N>
+struct GlyphTable {
+    Glyph glyphs[N];
+};
+
+template <typename Match, size_t... I>
+static constexpr GlyphTable<sizeof...(I)> make_glyph_table(Indices<I...>) {
+    return GlyphTable<sizeof...(I)>{ { find_glyph(Match{ I })... } };
+}
+
+static constexpr GlyphTable<0x80> ASCII_GLYPHS = make_glyph_table<IsCodepoint>(MakeIndices<0x80>::type());
+static constexpr GlyphTable<GLYPH_HASH_SLOTS> HASHED_GLYPHS = make_glyph_table<InSlot>(MakeIndices<GLYPH_HASH_SLOTS>::type());
+
+
+bool tile_for_codepoint(uint32_t codepoint, Tile &tile) {
+
+    const Glyph &g = codepoint < 0x80 ? ASCII_GLYPHS.glyphs[codepoint]
+                                      : HASHED_GLYPHS.glyphs[glyph_hash(codepoint)];
+
+    // a slot holds some glyph or none, so the character has to be checked
+    tile = g.codepoint == codepoint ? g.tile : FALLBACK_TILE;
+    return g.codepoint == codepoint;
+}
+
+
+uint32_t decode_utf8(const std::string &str, size_t pos, uint8_t &length) {
+
+    const uint8_t lead = (uint8_t)str[pos];
+
+    uint32_t codepoint;
+    uint32_t least; // the smallest codepoint to need this many bytes
+
+    if      (lead < 0x80)           { length = 1; return lead; }
+    else if ((lead & 0xE0) == 0xC0) { length = 2; codepoint = lead & 0x1F; least = 0x80;    }
+    else if ((lead & 0xF0) == 0xE0) { length = 3; codepoint = lead & 0x0F; least = 0x800;   }
+    else if ((lead & 0xF8) == 0xF0) { length = 4; codepoint = lead & 0x07; least = 0x10000; }
+    else                            { length = 1; return INVALID_CODEPOINT; }
+
+    for (uint8_t i = 1; i < length; i++) {
+        const uint8_t next = pos + i < str.size() ? (uint8_t)str[pos + i] : 0;
+
+        // a sequence cut short is skipped up to where it went wrong
+        if ((next & 0xC0) != 0x80) {
+            length = i;
+            return INVALID_CODEPOINT;
+        }
+        codepoint = codepoint << 6 | (next & 0x3F);
+    }
+
+    // overlong encodings, surrogates and anything past the last codepoint
+    if (codepoint < least || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+        return INVALID_CODEPOINT;
+
+    return codepoint;
+}
+
+
+TextToken read_token(const std::string &str, size_t pos) {
+
+    // Test for multi-character tokens, only where one could start
+    switch (str[pos]) {
+    case '!':
+        if (str.compare(pos, 3, "!!!") == 0) return TextToken{ Tile::PUNCT_EEEMARK,    3, false, true };
+        if (str.compare(pos, 2, "!?")  == 0) return TextToken{ Tile::PUNCT_EQMARK,     2, false, true };
+        break;
+    case '.':
+        if (str.compare(pos, 3, "...") == 0) return TextToken{ Tile::PUNCT_ELLIPSIS,   3, false, true };
+        break;
+    case '$':
+        if (str.compare(pos, 2, "$$")  == 0) return TextToken{ Tile::PUNCT_MONEY_BOLD, 2, false, true };
+        break;
+    case '/':
+        if (str.compare(pos, 2, "//")  == 0) return TextToken{ Tile::PUNCT_DIVIDE,     2, false, true };
+        break;
+    case '*':
+        if (str.compare(pos, 2, "**")  == 0) return TextToken{ Tile::PUNCT_MULTIPLY,   2, false, true };
+        break;
+    case '\n':
+        return TextToken{ Tile::PUNCT_SPACE, 1, true, true };
+    }
+
+    TextToken token{ FALLBACK_TILE, 1, false, false };
+    token.known = tile_for_codepoint(decode_utf8(str, pos, token.length), token.tile);
+    return token;
+}
+
+
+
+/* Laying out text */
+
+
+void wrap_tiles(const std::vector<Tile> &tiles, uint8_t width, std::vector<std::vector<Tile>> &lines, size_t limit) {
+
+    if (width == 0) return;
+
+    std::vector<Tile> line;
+    size_t spaces = 0; // between the end of `line` and the next word
+
+    for (size_t i = 0; i < tiles.size() && lines.size() <= limit;) {
+
+        if (tiles[i] == Tile::PUNCT_SPACE) {
+            spaces++;
+            i++;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < tiles.size() && tiles[end] != Tile::PUNCT_SPACE) end++;
+
+        if (line.size() + spaces + (end - i) <= width) {
+            line.insert(line.end(), spaces, Tile::PUNCT_SPACE);
+        } else {
+            // the spaces are dropped where the line wraps
+            if (!line.empty()) lines.push_back(line);
+            line.clear();
+
+            while (end - i > width) {
+                lines.emplace_back(tiles.begin() + i, tiles.begin() + i + width);
+                i += width;
+            }
+        }
+
+        line.insert(line.end(), tiles.begin() + i, tiles.begin() + end);
+        i      = end;
+        spaces = 0;
+    }
+
+    lines.push_back(line);
+}
+
+
+static void lay_out(const std::string &str, Pair<uint8_t> size, TextAlign align, TextLayout &out) {
+
+    const uint8_t width  = size.first;
+    const uint8_t height = size.second;
+
+    out.cells.clear();
+    out.lines     = 0;
+    out.truncated = false;
+
+    if (width == 0 || height == 0) {
+        out.truncated = !str.empty();
+        return;
+    }
+
+    std::vector<std::vector<Tile>> lines;
+    std::vector<Tile> paragraph; // since the last newline
+    bool ended = false;          // by a newline, with nothing after it yet
+
+    // once a line too many is found, the rest could never be seen
+    for (size_t i = 0; i < str.size() && lines.size() <= height;) {
+
+        const TextToken token = read_token(str, i);
+        i += token.length;
+        ended = token.newline;
+
+        if (token.newline) {
+            wrap_tiles(paragraph, width, lines, height);
+            paragraph.clear();
+        } else {
+            paragraph.push_back(token.tile);
+        }
+    }
+
+    // a newline at the very end doesn't start another line
+    if (!str.empty() && !ended && lines.size() <= height) wrap_tiles(paragraph, width, lines, height);
+
+
+    if (lines.size() > height) {
+        out.truncated = true;
+        lines.resize(height);
+
+        std::vector<Tile> &last = lines.back();
+        if (last.size() >= width) last.resize(width - 1);
+        last.push_back(Tile::PUNCT_ELLIPSIS);
+    }
+
+    out.lines = (uint8_t)lines.size();
+
+    for (uint8_t y = 0; y < lines.size(); y++) {
+        const std::vector<Tile> &l = lines[y];
+
+        uint8_t x = 0;
+        if      (align == TextAlign::CENTER) x = (width - l.size()) / 2;
+        else if (align == TextAlign::RIGHT)  x =  width - l.size();
+
+        for (Tile t : l) {
+            if (t != Tile::PUNCT_SPACE) out.cells.push_back(TextLayout::Cell{ t, std::make_pair(x, y) });
+            x++;
+        }
+    }
+}
+
+
+/* The layouts used most recently, and where to find each of them by text and box */
+struct LayoutCache {
+
+    struct Entry {
+        std::string key;
+        TextLayout  layout;
+    };
+
+    std::list<Entry> recent; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+};
+
+
+const TextLayout &layout_text(const std::string &str, Pair<uint8_t> size, TextAlign align) {
+
+    static LayoutCache cache;
+
+    // the box goes on the end, where it can't run into the text
+    std::string key(str);
+    key.push_back((char)size.first);
+    key.push_back((char)size.second);
+    key.push_back((char)align);
+
+    auto found = cache.index.find(key);
+    if (found != cache.index.end()) {
+        cache.recent.splice(cache.recent.begin(), cache.recent, found->second);
+        return found->second->layout;
+    }
+
+    // the least recently used layout makes way, and lends its cells to the new one
+    if (cache.recent.size() >= TEXT_CACHE_SIZE) {
+        cache.index.erase(cache.recent.back().key);
+        cache.recent.splice(cache.recent.begin(), cache.recent, std::prev(cache.recent.end()));
+        cache.recent.front().key = key;
+    } else {
+        cache.recent.push_front(LayoutCache::Entry{ key, TextLayout() });
+    }
+
+    cache.index.emplace(key, cache.recent.begin());
+
+    TextLayout &layout = cache.recent.front().layout;
+    lay_out(str, size, align, layout);
+    return layout;
+}
+
+
+bool draw_text(const std::string &str, Pair<int8_t> pos, Pair<uint8_t> size,
+               const Style &s, TextAlign align) {
+
+    for (const TextLayout::Cell &cell : layout_text(str, size, align).cells) {
+        const Pair<int8_t> at = std::make_pair(pos.first + cell.pos.first, pos.second + cell.pos.second);
+        if (!draw_tile(cell.tile, at, s)) return false;
+    }
+
+    return true;
+}
+
+
+
+/* Styling text with markup */
+
+
+/* What the tags seen so far add to the base style */
+struct MarkupState {
+    Color *color; // nullptr for none
+    bool   wave;
+
+    bool operator==(const MarkupState &o) const { return color == o.color && wave == o.wave; }
+};
+
+
+/* Change `state` by the tag `name`, returning false for a tag there is no such thing as */
+static bool apply_tag(const std::string &name, MarkupState &state) {
+
+    if      (name == "fg1")     state.color = color_from_palette(PaletteColor::FG_1);
+    else if (name == "fg2")     state.color = color_from_palette(PaletteColor::FG_2);
+    else if (name == "bg1")     state.color = color_from_palette(PaletteColor::BG_1);
+    else if (name == "bg2")     state.color = color_from_palette(PaletteColor::BG_2);
+    else if (name == "rainbow") state.color = color_rgb_sin();
+    else if (name == "wave")    state.wave  = true;
+    else if (name == "/")       state = MarkupState{ nullptr, false };
+    else return false;
+
+    return true;
+}
+
+
+StyledRun parse_markup(const std::string &markup, const Style &base) {
+
+    StyledRun run;
+
+    // the state each span was styled from, to find it again on switching back
+    std::vector<MarkupState> styled;
+
+    MarkupState state{ nullptr, false };
+    size_t span = SIZE_MAX; // none yet, until the first tile needs one
+
+    Pair<uint8_t> pos(0, 0);
+
+    for (size_t i = 0; i < markup.size();) {
+
+        if (markup[i] == '{') {
+            const size_t close = markup.find('}', i);
+            if (close == std::string::npos) {
+                fprintf(stderr, "Markup Error: unclosed tag in \"%s\"\n", markup.c_str());
+                break;
+            }
+
+            const std::string name = markup.substr(i + 1, close - i - 1);
+            if (!apply_tag(name, state)) fprintf(stderr, "Markup Error: unknown tag {%s}\n", name.c_str());
+
+            i = close + 1;
+            span = SIZE_MAX;
+            continue;
+        }
+
+        const TextToken token = read_token(markup, i);
+        i += token.length;
+
+        if (token.newline) {
+            pos.first = 0;
+            pos.second++;
+            continue;
+        }
+
+        if (token.tile != Tile::PUNCT_SPACE) {
+
+            if (span == SIZE_MAX) {
+                span = std::find(styled.begin(), styled.end(), state) - styled.begin();
+
+                if (span == styled.size()) {
+                    Style colored = state.color ? Style(base).compose(state.color) : base;
+
+                    styled.push_back(state);
+                    run.spans.push_back(StyledRun::Span{
+                        state.wave ? colored.compose(offset_hover_wave()) : colored, {}
+                    });
+                }
+            }
+
+            run.spans[span].cells.push_back(TextLayout::Cell{ token.tile, pos });
+        }
+
+        pos.first++;
+    }
+
+    return run;
+}
+
+
+bool draw_styled(const StyledRun &run, Pair<int8_t> pos) {
+
+    static TileBatch batch;
+    batch.clear();
+
+    for (const StyledRun::Span &span : run.spans) {
+        for (const TextLayout::Cell &cell : span.cells) {
+
+            const Pair<int8_t> at = std::make_pair(pos.first + cell.pos.first, pos.second + cell.pos.second);
+
+            // styles which vary from tile to tile look at where they are drawn
+            render_config.info.pos  = at;
+            render_config.info.tile = cell.tile;
+
+            const Pair<int16_t> offset = span.style.offset();
+
+            // a batch scales tiles evenly, so only the width's scale is kept
+            batch.add(cell.tile,
+                      at.first  + (float)offset.first  / TILE_RENDER_WIDTH,
+                      at.second + (float)offset.second / TILE_RENDER_HEIGHT,
+                      span.style.color(),
+                      span.style.scale().first);
+        }
+    }
+
+    return draw_tile_batch(batch);
+}
@@ -0,0 +1,139 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "style.h"
+
+
+/* The tile drawn for a character with no tile of its own */
+static constexpr Tile FALLBACK_TILE = Tile::PUNCT_QMARK;
+
+/* What bytes which are not UTF-8 decode as */
+static constexpr uint32_t INVALID_CODEPOINT = 0xFFFD;
+
+
+/*
+    Decode the UTF-8 character of `str` starting at `pos`,
+    setting `length` to the number of bytes read. Bytes which
+    are not UTF-8 are read as INVALID_CODEPOINT instead, up to
+    the first byte which could start a character again.
+*/
+uint32_t decode_utf8(const std::string &str, size_t pos, uint8_t &length);
+
+/* Find the tile for a character, setting FALLBACK_TILE and returning false if it has none */
+bool tile_for_codepoint(uint32_t codepoint, Tile &tile);
+
+
+/*
+    A single cell of text: one tile, though it may have been
+    written as several bytes (like "!!!", or "÷" in UTF-8),
+    or a line break.
+*/
+struct TextToken {
+    Tile    tile;
+    uint8_t length;  // the number of bytes it was written as
+    bool    newline; // a line break, which has no tile
+    bool    known;   // false for a character drawn as FALLBACK_TILE
+};
+
+
+/* Read the token of `str` (in UTF-8) starting at `pos` */
+TextToken read_token(const std::string &str, size_t pos);
+
+
+enum class TextAlign : uint8_t {
+    LEFT,
+    CENTER,
+    RIGHT,
+};
+
+
+/*
+    Text laid out in a box, as the position (in tiles, from the
+    top left of the box) of every tile to draw. Spaces are left
+    out, since there is nothing to draw for them.
+*/
+struct TextLayout {
+
+    struct Cell {
+        Tile          tile;
+        Pair<uint8_t> pos;
+    };
+
+    std::vector<Cell> cells;
+
+    uint8_t lines;     // the number of lines used
+    bool    truncated; // whether any of the text did not fit
+};
+
+
+/*
+    Lay `str` out in a box `size` tiles across and down. Lines
+    wrap between words, and words too long for a line of their
+    own are broken wherever the line ends. If there are more
+    lines than fit, the last line to fit ends in an ellipsis.
+
+    Layouts are cached, so laying out the same text in the same
+    box again (as every frame does) costs only a lookup. The
+    layout returned is only good until the next call.
+*/
+const TextLayout &layout_text(const std::string &str, Pair<uint8_t> size,
+                              TextAlign align = TextAlign::LEFT);
+
+
+/*
+    Wrap one line of tiles, with `PUNCT_SPACE` between its words,
+    onto the end of `lines`, no line more than `width` across, the
+    same way `layout_text` wraps each line of its text. Wrapping
+    stops once there are more than `limit` lines.
+*/
+void wrap_tiles(const std::vector<Tile> &, uint8_t width,
+                std::vector<std::vector<Tile>> &lines, size_t limit = SIZE_MAX);
+
+
+/* Draw `str` laid out in the box at `pos`, `size` tiles across and down */
+bool draw_text(const std::string &str, Pair<int8_t> pos, Pair<uint8_t> size,
+               const Style &, TextAlign align = TextAlign::LEFT);
+
+
+/*
+    Text with its style marked up inline, in tags between braces
+    which hold until the next tag changes them:
+
+        {fg1} {fg2} {bg1} {bg2}   a color from the palette
+        {rainbow}                 the color of `color_rgb_sin`
+        {wave}                    the `offset_hover_wave` offset
+        {/}                       back to the base style
+
+    Color tags replace one another, while `{wave}` holds along
+    with any of them, so "{wave}a{fg2}b" draws both letters
+    waving. Tags are composed over the base style, as styles
+    always are, so the colors come through as they are only
+    over a white base.
+
+    Markup is parsed once, into a run of spans each with its own
+    style, and a span for each different style no matter how
+    often the text switches back to it. The run is then drawn
+    as a single batch, so keep it around rather than parsing
+    the same text every frame: composing styles allocates.
+*/
+struct StyledRun {
+
+    struct Span {
+        Style                         style;
+        std::vector<TextLayout::Cell> cells;
+    };
+
+    std::vector<Span> spans;
+};
+
+
+/* Parse `markup` into a run, laid out like `draw_string` (so only `\n` breaks lines) */
+StyledRun parse_markup(const std::string &markup, const Style &base = style_default());
+
+
+/* Draw every span of the run at `pos`, all in one batch */
+bool draw_styled(const StyledRun &, Pair<int8_t> pos);
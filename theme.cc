@@ -0,0 +1,409 @@
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <array>
+#include <bitset>
+#include <algorithm>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "mappings.h"
+#include "theme.h"
+
+
+static constexpr size_t TILE_COUNT  = static_cast<size_t>(Tile::IDS_COUNT);
+static constexpr size_t COLOR_COUNT = static_cast<size_t>(PaletteColor::COLOR_COUNT);
+
+
+/* The names of the tiles, in the order of the `Tile` enum */
+static const char *const TILE_NAMES[] = {
+    "PLAIN_FILL",
+
+    "BORDER_N",                "BORDER_S",                "BORDER_E",                "BORDER_W",
+    "BORDER_NW",               "BORDER_NE",               "BORDER_SW",               "BORDER_SE",
+    "BORDER_NS",               "BORDER_WE",               "BORDER_NSW",              "BORDER_NSE",
+    "BORDER_SWE",              "BORDER_NWE",              "BORDER_NSWE",             "BORDER_NONE",
+
+    "BORDER_N_BOLD",           "BORDER_S_BOLD",           "BORDER_E_BOLD",           "BORDER_W_BOLD",
+    "BORDER_NW_BOLD",          "BORDER_NE_BOLD",          "BORDER_SW_BOLD",          "BORDER_SE_BOLD",
+    "BORDER_NS_BOLD",          "BORDER_WE_BOLD",          "BORDER_NSW_BOLD",         "BORDER_NSE_BOLD",
+    "BORDER_SWE_BOLD",         "BORDER_NWE_BOLD",         "BORDER_NSWE_BOLD",        "BORDER_NONE_BOLD",
+
+    "BORDER_ROUND_N",          "BORDER_ROUND_S",          "BORDER_ROUND_E",          "BORDER_ROUND_W",
+    "BORDER_ROUND_NW",         "BORDER_ROUND_NE",         "BORDER_ROUND_SW",         "BORDER_ROUND_SE",
+    "BORDER_ROUND_NS",         "BORDER_ROUND_WE",         "BORDER_ROUND_NSW",        "BORDER_ROUND_NSE",
+    "BORDER_ROUND_SWE",        "BORDER_ROUND_NWE",        "BORDER_ROUND_NSWE",       "BORDER_ROUND_NONE",
+
+    "BORDER_ROUND_N_BOLD",     "BORDER_ROUND_S_BOLD",     "BORDER_ROUND_E_BOLD",     "BORDER_ROUND_W_BOLD",
+    "BORDER_ROUND_NW_BOLD",    "BORDER_ROUND_NE_BOLD",    "BORDER_ROUND_SW_BOLD",    "BORDER_ROUND_SE_BOLD",
+    "BORDER_ROUND_NS_BOLD",    "BORDER_ROUND_WE_BOLD",    "BORDER_ROUND_NSW_BOLD",   "BORDER_ROUND_NSE_BOLD",
+    "BORDER_ROUND_SWE_BOLD",   "BORDER_ROUND_NWE_BOLD",   "BORDER_ROUND_NSWE_BOLD",  "BORDER_ROUND_NONE_BOLD",
+
+    "PUNCT_SPACE",             "PUNCT_FSTOP",             "PUNCT_COMMA",             "PUNCT_LQUOT",
+    "PUNCT_RQUOT",             "PUNCT_EMARK",             "PUNCT_QMARK",             "PUNCT_ELLIPSIS",
+    "PUNCT_COLON",             "PUNCT_LPAREN",            "PUNCT_RPAREN",            "PUNCT_EEEMARK",
+    "PUNCT_EQMARK",            "PUNCT_PLUS",              "PUNCT_MINUS",             "PUNCT_DIVIDE",
+    "PUNCT_MULTIPLY",          "PUNCT_LTSIGN",            "PUNCT_GTSIGN",            "PUNCT_SOLIDUS",
+    "PUNCT_MULTSMALL",         "PUNCT_MONEY",
+
+    "PUNCT_MONEY_BOLD",
+
+    "ALPHANUM_A",              "ALPHANUM_B",              "ALPHANUM_C",              "ALPHANUM_D",
+    "ALPHANUM_E",              "ALPHANUM_F",              "ALPHANUM_G",              "ALPHANUM_H",
+    "ALPHANUM_I",              "ALPHANUM_J",              "ALPHANUM_K",              "ALPHANUM_L",
+    "ALPHANUM_M",              "ALPHANUM_N",              "ALPHANUM_O",              "ALPHANUM_P",
+    "ALPHANUM_Q",              "ALPHANUM_R",              "ALPHANUM_S",              "ALPHANUM_T",
+    "ALPHANUM_U",              "ALPHANUM_V",              "ALPHANUM_W",              "ALPHANUM_X",
+    "ALPHANUM_Y",              "ALPHANUM_Z",
+
+    "ALPHANUM_A_BOLD",         "ALPHANUM_B_BOLD",         "ALPHANUM_C_BOLD",         "ALPHANUM_D_BOLD",
+    "ALPHANUM_E_BOLD",         "ALPHANUM_F_BOLD",         "ALPHANUM_G_BOLD",         "ALPHANUM_H_BOLD",
+    "ALPHANUM_I_BOLD",         "ALPHANUM_J_BOLD",         "ALPHANUM_K_BOLD",         "ALPHANUM_L_BOLD",
+    "ALPHANUM_M_BOLD",         "ALPHANUM_N_BOLD",         "ALPHANUM_O_BOLD",         "ALPHANUM_P_BOLD",
+    "ALPHANUM_Q_BOLD",         "ALPHANUM_R_BOLD",         "ALPHANUM_S_BOLD",         "ALPHANUM_T_BOLD",
+    "ALPHANUM_U_BOLD",         "ALPHANUM_V_BOLD",         "ALPHANUM_W_BOLD",         "ALPHANUM_X_BOLD",
+    "ALPHANUM_Y_BOLD",         "ALPHANUM_Z_BOLD",
+
+    "ALPHANUM_0",              "ALPHANUM_1",              "ALPHANUM_2",              "ALPHANUM_3",
+    "ALPHANUM_4",              "ALPHANUM_5",              "ALPHANUM_6",              "ALPHANUM_7",
+    "ALPHANUM_8",              "ALPHANUM_9",
+
+    "MENU_CURSOR_SELECTED",    "MENU_CURSOR_UNSELECTED",
+};
+
+static_assert(sizeof(TILE_NAMES) / sizeof(TILE_NAMES[0]) == TILE_COUNT,
+              "every tile needs a name, in the order of the Tile enum");
+
+
+static const char *const COLOR_NAMES[] = { "BG_1", "BG_2", "FG_1", "FG_2" };
+
+static_assert(sizeof(COLOR_NAMES) / sizeof(COLOR_NAMES[0]) == COLOR_COUNT,
+              "every palette color needs a name, in the order of the PaletteColor enum");
+
+
+const char *tile_name(Tile t) {
+    return static_cast<size_t>(t) < TILE_COUNT ? TILE_NAMES[static_cast<size_t>(t)] : "?";
+}
+
+
+
+/*
+    Looking up names. Tiles are found by a binary search over
+    their names in sorted order, which is worked out only once.
+*/
+
+/* Compare a name with the `len` characters at `word` */
+static int compare_name(const char *name, const char *word, size_t len) {
+    const int c = strncmp(name, word, len);
+    return c ? c : (name[len] != '\0');
+}
+
+
+static int find_tile(const char *word, size_t len) {
+
+    static const std::array<uint8_t, TILE_COUNT> sorted = []() {
+        std::array<uint8_t, TILE_COUNT> order;
+        for (size_t t = 0; t < TILE_COUNT; t++) order[t] = (uint8_t)t;
+        std::sort(order.begin(), order.end(), [](uint8_t a, uint8_t b) {
+            return strcmp(TILE_NAMES[a], TILE_NAMES[b]) < 0;
+        });
+        return order;
+    }();
+
+    size_t lo = 0, hi = TILE_COUNT;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        const int    c   = compare_name(TILE_NAMES[sorted[mid]], word, len);
+        if (c == 0) return sorted[mid];
+        if (c < 0) lo = mid + 1;
+        else       hi = mid;
+    }
+    return -1;
+}
+
+
+static int find_color(const char *word, size_t len) {
+    for (size_t c = 0; c < COLOR_COUNT; c++)
+        if (compare_name(COLOR_NAMES[c], word, len) == 0) return (int)c;
+    return -1;
+}
+
+
+
+/*
+    Parsing. The whole file is read into memory, then each
+    line is picked apart in place by a cursor moving over it.
+*/
+
+namespace {
+
+    struct Cursor {
+        const char *p, *end;
+        unsigned    line;
+    };
+
+}
+
+
+static void skip_blanks(Cursor &c) {
+    while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\r')) c.p++;
+}
+
+
+/* True once only a comment (or nothing) is left on the line */
+static bool at_line_end(Cursor &c) {
+    skip_blanks(c);
+    return c.p == c.end || *c.p == '\n' || *c.p == '#';
+}
+
+
+static void next_line(Cursor &c) {
+    while (c.p < c.end && *c.p != '\n') c.p++;
+    if (c.p < c.end) c.p++;
+    c.line++;
+}
+
+
+/*
+    The next run of characters up to a blank. Comments are only
+    noticed between words, so that colors can start with '#' too.
+*/
+static size_t word(Cursor &c, const char *&start) {
+    skip_blanks(c);
+    start = c.p;
+    while (c.p < c.end && *c.p != ' ' && *c.p != '\t' && *c.p != '\r' && *c.p != '\n') c.p++;
+    return c.p - start;
+}
+
+
+static bool number(Cursor &c, unsigned max, unsigned &out) {
+    const char *start;
+    const size_t len = word(c, start);
+    if (len == 0) return false;
+
+    out = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (start[i] < '0' || start[i] > '9') return false;
+        out = out * 10 + (start[i] - '0');
+        if (out > max) return false;
+    }
+    return true;
+}
+
+
+static int hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+
+static bool hex_color(Cursor &c, ColorRGBA &out) {
+    const char *start;
+    const size_t len = word(c, start);
+    if ((len != 7 && len != 9) || start[0] != '#') return false;
+
+    uint8_t channels[4] = { 0, 0, 0, 0xFF };
+    for (size_t i = 0; i < (len - 1) / 2; i++) {
+        const int hi = hex_digit(start[1 + 2 * i]);
+        const int lo = hex_digit(start[2 + 2 * i]);
+        if (hi < 0 || lo < 0) return false;
+        channels[i] = (uint8_t)(hi << 4 | lo);
+    }
+
+    out = ColorRGBA(channels[0], channels[1], channels[2], channels[3]);
+    return true;
+}
+
+
+/* What is left of the line, for reporting */
+static int rest_of_line(const Cursor &c) {
+    const char *eol = c.p;
+    while (eol < c.end && *eol != '\n' && *eol != '\r') eol++;
+    return (int)(eol - c.p);
+}
+
+
+static bool theme_error(const std::string &path, unsigned line, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Theme Error: %s:%u: ", path.c_str(), line);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return false;
+}
+
+
+bool load_theme(const std::string &path, Theme &out) {
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "Theme Error: could not open %s\n", path.c_str());
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    const long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    std::string text(length > 0 ? length : 0, '\0');
+    const bool read = text.empty() || fread(&text[0], 1, text.size(), f) == text.size();
+    fclose(f);
+
+    if (!read) {
+        fprintf(stderr, "Theme Error: could not read %s\n", path.c_str());
+        return false;
+    }
+
+
+    // Everything is parsed into here first, so a broken file changes nothing
+    Theme theme;
+    theme.source.fill(0);
+    theme.colors.fill(ColorRGBA(0, 0, 0, 0xFF));
+
+    std::array<Pair<uint8_t>, TILE_COUNT> cells;
+
+    Cursor c{ text.data(), text.data() + text.size(), 1 };
+
+    for (; c.p < c.end; next_line(c)) {
+
+        if (at_line_end(c)) continue;
+
+        const char *directive;
+        const size_t dlen = word(c, directive);
+
+        const char *name;
+        size_t      nlen;
+
+        if (compare_name("tile", directive, dlen) == 0) {
+
+            nlen = word(c, name);
+            const int t = find_tile(name, nlen);
+            if (t < 0) return theme_error(path, c.line, "unknown tile '%.*s'", (int)nlen, name);
+            if (theme.mapped[t]) return theme_error(path, c.line, "tile %s is given twice", TILE_NAMES[t]);
+            if (theme.tilesets.empty()) return theme_error(path, c.line, "tile %s comes before any texture", TILE_NAMES[t]);
+
+            unsigned col, row;
+            if (!number(c, 255, col) || !number(c, 255, row))
+                return theme_error(path, c.line, "tile %s needs a column and row from 0 to 255", TILE_NAMES[t]);
+
+            cells[t] = std::make_pair((uint8_t)col, (uint8_t)row);
+            theme.source[t] = (uint8_t)(theme.tilesets.size() - 1);
+            theme.mapped[t] = true;
+
+        } else if (compare_name("color", directive, dlen) == 0) {
+
+            nlen = word(c, name);
+            const int pc = find_color(name, nlen);
+            if (pc < 0) return theme_error(path, c.line, "unknown color '%.*s'", (int)nlen, name);
+            if (theme.colored[pc]) return theme_error(path, c.line, "color %s is given twice", COLOR_NAMES[pc]);
+
+            if (!hex_color(c, theme.colors[pc]))
+                return theme_error(path, c.line, "color %s needs to be #RRGGBB or #RRGGBBAA", COLOR_NAMES[pc]);
+
+            theme.colored[pc] = true;
+
+        } else if (compare_name("tile_size", directive, dlen) == 0) {
+
+            unsigned w, h;
+            if (!number(c, 255, w) || !number(c, 255, h) || w == 0 || h == 0)
+                return theme_error(path, c.line, "tile_size needs a width and height from 1 to 255");
+            if (theme.tilesets.empty()) return theme_error(path, c.line, "tile_size comes before any texture");
+
+            theme.tilesets.back().tile_size = std::make_pair((uint8_t)w, (uint8_t)h);
+
+        } else if (compare_name("texture", directive, dlen) == 0) {
+
+            nlen = word(c, name);
+            if (nlen == 0) return theme_error(path, c.line, "texture needs a file");
+            if (theme.tilesets.size() == 256) return theme_error(path, c.line, "too many textures");
+
+            theme.tilesets.push_back(Theme::Tileset{ std::string(name, nlen), std::make_pair(0, 0) });
+
+        } else {
+            return theme_error(path, c.line, "unknown directive '%.*s'", (int)dlen, directive);
+        }
+
+        if (!at_line_end(c)) return theme_error(path, c.line, "unexpected '%.*s'", rest_of_line(c), c.p);
+    }
+
+    if (theme.tilesets.empty()) {
+        fprintf(stderr, "Theme Error: %s needs a texture\n", path.c_str());
+        return false;
+    }
+
+    for (const Theme::Tileset &set : theme.tilesets) {
+        if (set.tile_size.first == 0) {
+            fprintf(stderr, "Theme Error: %s needs a tile_size for %s\n", path.c_str(), set.texture.c_str());
+            return false;
+        }
+    }
+
+
+    /* Emit the legend, now that the tile sizes are surely known */
+
+    for (size_t t = 0; t < TILE_COUNT; t++) {
+        const Pair<uint8_t> size = theme.tilesets[theme.source[t]].tile_size;
+        theme.legend[t] = !theme.mapped[t] ? SDL_Rect{ 0, 0, 0, 0 } : SDL_Rect{
+            cells[t].first  * size.first,
+            cells[t].second * size.second,
+            size.first,
+            size.second
+        };
+    }
+
+
+    /* Report (but allow) anything left out */
+
+    if (!theme.mapped.all()) {
+        fprintf(stderr, "Theme Warning: %s leaves %u tiles unmapped:",
+                path.c_str(), (unsigned)(TILE_COUNT - theme.mapped.count()));
+        for (size_t t = 0; t < TILE_COUNT; t++)
+            if (!theme.mapped[t]) fprintf(stderr, " %s", TILE_NAMES[t]);
+        fputc('\n', stderr);
+    }
+
+    if (!theme.colored.all()) {
+        fprintf(stderr, "Theme Warning: %s leaves %u colors unset (they will be black)\n",
+                path.c_str(), (unsigned)(COLOR_COUNT - theme.colored.count()));
+    }
+
+    out = theme;
+    return true;
+}
+
+
+
+Palette *Theme::palette() const {
+    Palette *palette = new Palette(COLOR_COUNT);
+    for (size_t c = 0; c < COLOR_COUNT; c++)
+        palette->emplace(PaletteColor(c), colors[c]);
+    return palette;
+}
+
+
+
+Theme default_theme() {
+
+    Theme theme;
+    theme.tilesets.push_back(Theme::Tileset{ DEFAULT_TEXTURE_BMP, DEFAULT_TILE_SIZE });
+    theme.legend = legend_from_mapping(DEFAULT_TILE_SIZE, Mappings::default_texture_map());
+    theme.source.fill(0);
+
+    for (size_t t = 0; t < TILE_COUNT; t++)
+        theme.mapped[t] = theme.legend[t].w != 0;
+
+    const Palette &palette = *Mappings::default_palette();
+    for (size_t c = 0; c < COLOR_COUNT; c++) {
+        auto it = palette.find(PaletteColor(c));
+        theme.colors[c]  = it != palette.end() ? it->second : ColorRGBA(0, 0, 0, 0xFF);
+        theme.colored[c] = it != palette.end();
+    }
+
+    return theme;
+}
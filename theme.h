@@ -0,0 +1,78 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <bitset>
+
+#include "types.h"
+#include "render.h"
+
+
+/* For each tile, the index of the tileset it comes from */
+typedef std::array<uint8_t, static_cast<size_t>(Tile::IDS_COUNT)> TileSources;
+
+
+/*
+    Everything which decides how the game looks: the textures
+    to draw tiles from, where each tile lies within them, and
+    the palette. Themes are read from text files, so they can
+    be swapped (or modded) without recompiling.
+
+    A theme file has one directive per line, and `#` starts
+    a comment which runs to the end of the line:
+
+        texture   ./assets/textures/tilemap.bmp
+        tile_size 16 16
+        color     BG_1 #606060
+        tile      BORDER_N 0 9
+
+    Each `texture` starts a new tileset, with its own tile
+    size, and the tiles which follow it are found within it.
+    Tilesets are packed into a single atlas when loaded.
+
+    Tiles and palette colors are named exactly as they are
+    in the `Tile` and `PaletteColor` enums. Columns and rows
+    are in tiles, and colors are #RRGGBB or #RRGGBBAA.
+*/
+struct Theme {
+
+    struct Tileset {
+        std::string   texture;
+        Pair<uint8_t> tile_size;
+    };
+
+    std::vector<Tileset> tilesets;
+
+    // the region of each tile within its own tileset
+    TileLegend   legend;
+    TileSources  source;
+
+    PaletteTable colors;
+
+    // which tiles and colors the theme gave
+    std::bitset<static_cast<size_t>(Tile::IDS_COUNT)>           mapped;
+    std::bitset<static_cast<size_t>(PaletteColor::COLOR_COUNT)> colored;
+
+    /* A new palette with the theme's colors, which belongs to the caller */
+    Palette *palette() const;
+
+};
+
+
+/*
+    Read a theme file into `out`, in a single pass over it.
+    Returns false, leaving `out` untouched, if the file cannot
+    be read or has any mistake in it. Tiles and colors the file
+    leaves out are reported, but are not mistakes.
+*/
+bool load_theme(const std::string &path, Theme &out);
+
+
+/* The theme built into the game, from the tables in mappings.cc */
+Theme default_theme();
+
+
+/* The name of a tile, as written in theme files */
+const char *tile_name(Tile);
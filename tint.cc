@@ -0,0 +1,194 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include "types.h"
+#include "state.h"
+#include "render.h"
+#include "tint.h"
+
+
+// The width and height of each texture the tinted tiles are kept in
+static constexpr uint16_t TINT_PAGE_SIZE = 512u;
+
+
+constexpr uint32_t TintCache::NONE;
+
+
+
+TintCache::TintCache(size_t budget)
+    : budget{budget}
+    , slot_w{0}, slot_h{0}, per_row{0}, per_page{0}, _capacity{0}
+    , head{NONE}, tail{NONE}
+    , generation{0}, usable{false}
+    , stale{true} { }
+
+
+TintCache::~TintCache() {
+    for (SDL_Texture *page : pages) SDL_DestroyTexture(page);
+}
+
+
+void TintCache::clear() {
+    stale = true;
+}
+
+
+size_t TintCache::size()     const { return lookup.size(); }
+size_t TintCache::capacity() const { return _capacity; }
+
+
+/* Throw everything away, and size the slots for the current tile map */
+void TintCache::reset() {
+
+    for (SDL_Texture *page : pages) SDL_DestroyTexture(page);
+    pages.clear();
+    slots.clear();
+    lookup.clear();
+    head = tail = NONE;
+
+    generation = render_config.generation();
+    stale      = false;
+    usable     = false;
+
+    if (!render_config.has_tile_map() || !SDL_RenderTargetSupported(renderer)) return;
+
+    slot_w = slot_h = 0;
+    for (uint16_t t = 0; t < static_cast<uint16_t>(Tile::IDS_COUNT); t++) {
+        const SDL_Rect r = render_config.tile_map().region(Tile(t));
+        slot_w = std::max<uint16_t>(slot_w, r.w);
+        slot_h = std::max<uint16_t>(slot_h, r.h);
+    }
+
+    if (slot_w == 0 || slot_h == 0 || slot_w > TINT_PAGE_SIZE || slot_h > TINT_PAGE_SIZE) return;
+
+    per_row  = TINT_PAGE_SIZE / slot_w;
+    per_page = per_row * (TINT_PAGE_SIZE / slot_h);
+
+    // always at least one page, however small the budget
+    const size_t page_bytes = (size_t)TINT_PAGE_SIZE * TINT_PAGE_SIZE * 4;
+    _capacity = (uint32_t)std::max<size_t>(budget / page_bytes, 1) * per_page;
+
+    usable = true;
+}
+
+
+SDL_Rect TintCache::slot_region(uint32_t slot) const {
+    const uint32_t i = slot % per_page;
+    return SDL_Rect{ (int)(i % per_row) * slot_w, (int)(i / per_row) * slot_h, slot_w, slot_h };
+}
+
+
+void TintCache::unlink(uint32_t slot) {
+    Slot &s = slots[slot];
+    if (s.prev != NONE) slots[s.prev].next = s.next; else head = s.next;
+    if (s.next != NONE) slots[s.next].prev = s.prev; else tail = s.prev;
+    s.prev = s.next = NONE;
+}
+
+
+void TintCache::push_front(uint32_t slot) {
+    Slot &s = slots[slot];
+    s.prev = NONE;
+    s.next = head;
+    if (head != NONE) slots[head].prev = slot; else tail = slot;
+    head = slot;
+}
+
+
+/* Draw `tile` from the atlas into `slot`, tinted `color` */
+bool TintCache::tint(uint32_t slot, Tile tile, ColorRGBA color) {
+
+    const uint32_t page = slot / per_page;
+
+    while (pages.size() <= page) {
+        SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                                 TINT_PAGE_SIZE, TINT_PAGE_SIZE);
+        if (texture == nullptr) {
+            fprintf(stderr, "SDL_CreateTexture Error: %s\n", SDL_GetError());
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        pages.push_back(texture);
+    }
+
+    SDL_Texture *atlas = render_config.tile_map().atlas();
+
+    const SDL_Rect src = render_config.tile_map().region(tile);
+    SDL_Rect dst = slot_region(slot);
+    dst.w = src.w;
+    dst.h = src.h;
+
+    // whatever was being drawn to is drawn to again afterwards
+    SDL_Texture  *target = SDL_GetRenderTarget(renderer);
+    SDL_BlendMode blend;
+    SDL_GetTextureBlendMode(atlas, &blend);
+
+    // with no blending, the tinted pixels (alpha too) replace the old slot outright
+    SDL_SetRenderTarget(renderer, pages[page]);
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_NONE);
+    SDL_SetTextureColorMod(atlas, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(atlas, color.a);
+
+    const bool ok = SDL_RenderCopy(renderer, atlas, &src, &dst) == 0;
+
+    SDL_SetTextureBlendMode(atlas, blend);
+    SDL_SetRenderTarget(renderer, target);
+
+    if (!ok) fprintf(stderr, "SDL_RenderCopy Error: %s\n", SDL_GetError());
+    return ok;
+}
+
+
+bool TintCache::find(Tile tile, ColorRGBA color, SDL_Texture *&texture, SDL_Rect &region) {
+
+    if (stale || generation != render_config.generation()) reset();
+    if (!usable) return false;
+
+    const SDL_Rect src = render_config.tile_map().region(tile);
+    if (src.w <= 0 || src.h <= 0) return false;
+
+    const uint64_t key = (uint64_t)static_cast<uint8_t>(tile) << 32
+                       | (uint32_t)color.r << 24 | (uint32_t)color.g << 16
+                       | (uint32_t)color.b << 8  | color.a;
+
+    uint32_t slot;
+    auto it = lookup.find(key);
+
+    if (it != lookup.end()) {
+        slot = it->second;
+        unlink(slot);
+
+    } else {
+
+        if (slots.size() < _capacity) {
+            slot = (uint32_t)slots.size();
+            slots.push_back(Slot{ key, NONE, NONE });
+        } else {
+            // give up the least recently used slot
+            slot = tail;
+            unlink(slot);
+            lookup.erase(slots[slot].key);
+            slots[slot].key = key;
+        }
+
+        if (!tint(slot, tile, color)) {
+            // without a way to tint, stop trying until the next reset
+            usable = false;
+            return false;
+        }
+
+        lookup.emplace(key, slot);
+    }
+
+    push_front(slot);
+
+    texture = pages[slot / per_page];
+    region  = slot_region(slot);
+    region.w = src.w;
+    region.h = src.h;
+    return true;
+}
@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <vector>
+#include <unordered_map>
+
+#include "types.h"
+
+
+/*
+    Copies of tiles already tinted in the colors they are drawn
+    in, so that drawing them needs no change of color modulation.
+    Tiles drawn in the same few (usually palette) colors then all
+    come from the same untinted textures, and batch together.
+
+    Tinted tiles are drawn into slots of a few large target
+    textures, all the size of the largest tile, with the least
+    recently used slot given up once `budget` bytes are spent.
+    Everything is thrown away whenever the palette or tile map
+    of `render_config` is replaced.
+*/
+class TintCache {
+public:
+
+    explicit TintCache(size_t budget);
+    ~TintCache();
+
+    TintCache(const TintCache &) = delete;
+    TintCache &operator=(const TintCache &) = delete;
+
+    /*
+        Find `tile` tinted `color`, tinting it first if need be.
+        Returns false if it cannot be cached, in which case
+        the tile should be drawn as usual.
+    */
+    bool find(Tile tile, ColorRGBA color, SDL_Texture *&texture, SDL_Rect &region);
+
+    void clear();
+
+    size_t size()     const;
+    size_t capacity() const;
+
+private:
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Slot {
+        uint64_t key;
+        uint32_t prev, next; // in order of use, most recent first
+    };
+
+    void     reset();
+    SDL_Rect slot_region(uint32_t slot) const;
+    bool     tint(uint32_t slot, Tile, ColorRGBA);
+    void     unlink(uint32_t slot);
+    void     push_front(uint32_t slot);
+
+    size_t budget;
+
+    std::vector<SDL_Texture *> pages;
+    uint16_t slot_w, slot_h, per_row;
+    uint32_t per_page;
+    uint32_t _capacity;
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint64_t, uint32_t> lookup;
+    uint32_t head, tail;
+
+    uint32_t generation; // of render_config, when last reset
+    bool     usable;
+    bool     stale;
+
+};
@@ -0,0 +1,30 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "state.h"
+#include "theme.h"
+#include "pack.h"
+
+
+/*
+    Bake the default asset pack ahead of time, so the first
+    launch of the game does not have to. The game still
+    bakes it again by itself whenever it has gone stale.
+
+    usage: bake_pack [theme file] [pack file]
+*/
+int main(int argc, char **argv) {
+
+    const char *theme_file = argc > 1 ? argv[1] : DEFAULT_THEME;
+    const char *pack_file  = argc > 2 ? argv[2] : DEFAULT_ASSET_PACK;
+
+    Theme theme;
+    if (!load_theme(theme_file, theme)) return 1;
+
+    if (!bake_pack(theme, pack_file)) return 1;
+
+    printf("baked %s into %s\n", theme_file, pack_file);
+    return 0;
+}
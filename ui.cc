@@ -0,0 +1,424 @@
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "state.h"
+#include "style.h"
+#include "render.h"
+#include "autotile.h"
+#include "text.h"
+#include "ui.h"
+
+
+
+/* Helpers */
+
+
+static uint8_t clamp_tiles(size_t n) {
+    return (uint8_t)std::min<size_t>(n, UINT8_MAX);
+}
+
+
+/* The size of `str` with no wrapping, in tiles across (the longest line) and lines */
+static Pair<uint8_t> text_extent(const std::string &str) {
+
+    size_t width = 0, line = 0, lines = str.empty() ? 0 : 1;
+    bool   ended = false;
+
+    for (size_t i = 0; i < str.size();) {
+        const TextToken token = read_token(str, i);
+        i += token.length;
+        ended = token.newline;
+
+        if (token.newline) {
+            line = 0;
+            lines++;
+        } else {
+            width = std::max(width, ++line);
+        }
+    }
+
+    // as laid out, a newline at the very end doesn't start another line
+    if (ended) lines--;
+
+    return std::make_pair(clamp_tiles(width), clamp_tiles(lines));
+}
+
+
+/* Paint `str` laid out in the box at `pos`, `size` tiles across and down */
+static void paint_text(std::vector<UICell> &cells, const std::string &str, Pair<uint8_t> pos,
+                       Pair<uint8_t> size, PaletteColor color, TextAlign align = TextAlign::LEFT) {
+
+    for (const TextLayout::Cell &cell : layout_text(str, size, align).cells) {
+        const Pair<uint8_t> at = std::make_pair(pos.first + cell.pos.first, pos.second + cell.pos.second);
+        cells.push_back(UICell{ cell.tile, at, color });
+    }
+}
+
+
+
+/* Implementation of Widget */
+
+
+Widget::Widget()
+    : parent{nullptr}, layer{nullptr}
+    , _wanted(0, 0), _pos(0, 0), _size(0, 0) { }
+
+Widget::~Widget() { }
+
+
+Pair<uint8_t> Widget::position() const { return _pos;  }
+Pair<uint8_t> Widget::size()     const { return _size; }
+
+
+void Widget::changed() {
+    const Widget *root = this;
+    while (root->parent) root = root->parent;
+
+    if (root->layer) root->layer->invalidate();
+}
+
+
+void Widget::arrange() { }
+
+
+Pair<uint8_t> Widget::wanted(const Widget &child) {
+    return child._wanted;
+}
+
+
+void Widget::place(Widget &child, Pair<uint8_t> pos, Pair<uint8_t> size) {
+    child.arrange_tree(pos, size);
+}
+
+
+void Widget::measure_tree() {
+    for (const std::unique_ptr<Widget> &child : children) child->measure_tree();
+    _wanted = measure();
+}
+
+
+void Widget::arrange_tree(Pair<uint8_t> pos, Pair<uint8_t> size) {
+    _pos  = pos;
+    _size = size;
+    arrange();
+}
+
+
+void Widget::paint_tree(std::vector<UICell> &cells) const {
+    paint(cells);
+    for (const std::unique_ptr<Widget> &child : children) child->paint_tree(cells);
+}
+
+
+
+/* Implementation of Label */
+
+
+Label::Label(const std::string &text, PaletteColor color, uint8_t width, TextAlign align)
+    : _text{text}, color{color}, width{width}, align{align} { }
+
+
+const std::string &Label::text() const { return _text; }
+
+void Label::text(const std::string &text) {
+    if (text == _text) return;
+    _text = text;
+    changed();
+}
+
+
+Pair<uint8_t> Label::measure() const {
+    if (width == 0) return text_extent(_text);
+
+    // as many lines as it takes to wrap at the width asked for
+    return std::make_pair(width, layout_text(_text, std::make_pair(width, UINT8_MAX), align).lines);
+}
+
+
+void Label::paint(std::vector<UICell> &cells) const {
+    paint_text(cells, _text, position(), size(), color, align);
+}
+
+
+
+/* Implementation of List */
+
+
+Pair<uint8_t> List::measure() const {
+
+    size_t width = 0, height = 0;
+
+    for (const std::unique_ptr<Widget> &child : children) {
+        const Pair<uint8_t> w = wanted(*child);
+        width   = std::max<size_t>(width, w.first);
+        height += w.second;
+    }
+
+    return std::make_pair(clamp_tiles(width), clamp_tiles(height));
+}
+
+
+void List::stack(Pair<uint8_t> origin, uint8_t width) {
+
+    size_t y = origin.second;
+
+    for (const std::unique_ptr<Widget> &child : children) {
+        const uint8_t height = wanted(*child).second;
+        place(*child, std::make_pair(origin.first, clamp_tiles(y)), std::make_pair(width, height));
+        y += height;
+    }
+}
+
+
+void List::arrange() {
+    stack(position(), size().first);
+}
+
+
+void List::paint(std::vector<UICell> &) const { }
+
+
+
+/* Implementation of Panel */
+
+
+Panel::Panel(Tile border, PaletteColor color, const std::string &title)
+    : border{Autotile::is_border(border) ? border : Tile::BORDER_NONE}, color{color}, title{title} { }
+
+
+Pair<uint8_t> Panel::measure() const {
+    const Pair<uint8_t> inner = List::measure();
+
+    // the title sits over the top edge, between the corners
+    const size_t width = std::max<size_t>(inner.first, title.empty() ? 0 : text_extent(title).first + 2);
+
+    return std::make_pair(clamp_tiles(width + 2), clamp_tiles(inner.second + 2));
+}
+
+
+void Panel::arrange() {
+    const Pair<uint8_t> at = position();
+    stack(std::make_pair(at.first + 1, at.second + 1), size().first >= 2 ? size().first - 2 : 0);
+}
+
+
+void Panel::paint(std::vector<UICell> &cells) const {
+
+    using namespace Autotile;
+
+    const Pair<uint8_t> at = position();
+    const uint8_t w = size().first;
+    const uint8_t h = size().second;
+    if (w < 2 || h < 2) return;
+
+    auto frame = [&](uint8_t x, uint8_t y, uint8_t mask) {
+        cells.push_back(UICell{ border_for(border, mask), std::make_pair(at.first + x, at.second + y), color });
+    };
+
+    frame(0,     0,     S | E);
+    frame(w - 1, 0,     S | W);
+    frame(0,     h - 1, N | E);
+    frame(w - 1, h - 1, N | W);
+
+    // the title, one tile in from the corner, breaks the top edge
+    const uint8_t title_w = title.empty() ? 0 : std::min<uint8_t>(text_extent(title).first, w - 2);
+
+    for (uint8_t x = 1; x < w - 1; x++) {
+        if (x > title_w) frame(x, 0, W | E);
+        frame(x, h - 1, W | E);
+    }
+
+    for (uint8_t y = 1; y < h - 1; y++) {
+        frame(0,     y, N | S);
+        frame(w - 1, y, N | S);
+    }
+
+    if (title_w) paint_text(cells, title, std::make_pair(at.first + 1, at.second), std::make_pair(title_w, 1), color);
+}
+
+
+
+/* Implementation of Menu */
+
+
+Menu::Menu(const std::vector<std::string> &items, PaletteColor color, PaletteColor selected)
+    : _items{items}, color{color}, selected_color{selected}, _selected{0} { }
+
+
+const std::vector<std::string> &Menu::items() const { return _items; }
+
+void Menu::items(const std::vector<std::string> &items) {
+    _items = items;
+    if (_selected >= _items.size()) _selected = _items.empty() ? 0 : _items.size() - 1;
+    changed();
+}
+
+
+size_t Menu::selected() const { return _selected; }
+
+void Menu::select(size_t i) {
+    if (i >= _items.size() || i == _selected) return;
+    _selected = i;
+    changed();
+}
+
+void Menu::move(int by) {
+    if (_items.empty()) return;
+    const int n = (int)_items.size();
+    select((size_t)((((int)_selected + by) % n + n) % n));
+}
+
+
+Pair<uint8_t> Menu::measure() const {
+
+    size_t width = 0;
+    for (const std::string &item : _items) width = std::max<size_t>(width, text_extent(item).first);
+
+    // a cursor and a space before every item
+    return std::make_pair(clamp_tiles(width + 2), clamp_tiles(_items.size()));
+}
+
+
+void Menu::paint(std::vector<UICell> &cells) const {
+
+    const Pair<uint8_t> at = position();
+    const uint8_t rows = std::min<size_t>(_items.size(), size().second);
+    const uint8_t text_w = size().first >= 2 ? size().first - 2 : 0;
+
+    for (uint8_t i = 0; i < rows; i++) {
+        const bool chosen = i == _selected;
+        const PaletteColor c = chosen ? selected_color : color;
+
+        const Tile cursor = chosen ? Tile::MENU_CURSOR_SELECTED : Tile::MENU_CURSOR_UNSELECTED;
+        cells.push_back(UICell{ cursor, std::make_pair(at.first, at.second + i), c });
+
+        if (text_w) paint_text(cells, _items[i], std::make_pair(at.first + 2, at.second + i), std::make_pair(text_w, 1), c);
+    }
+}
+
+
+
+/* Implementation of UILayer */
+
+
+UILayer::UILayer(Widget *&&root, Pair<int8_t> pos)
+    : _root{root}, pos{pos}, size(0, 0)
+    , texture{nullptr}, texture_w{0}, texture_h{0}
+    , generation{0}, dirty{true}, baked{false}, usable{true}
+    , _layouts{0}, _bakes{0} {
+
+    _root->layer = this;
+}
+
+
+UILayer::~UILayer() {
+    if (texture) SDL_DestroyTexture(texture);
+}
+
+
+Widget &UILayer::root() { return *_root; }
+
+void UILayer::move(Pair<int8_t> to) { pos = to; }
+
+void UILayer::invalidate() { dirty = true; }
+
+uint32_t UILayer::layouts() const { return _layouts; }
+uint32_t UILayer::bakes()   const { return _bakes;   }
+
+
+void UILayer::lay_out() {
+
+    _root->measure_tree();
+    size = _root->_wanted;
+    _root->arrange_tree(std::make_pair(0, 0), size);
+
+    cells.clear();
+    _root->paint_tree(cells);
+
+    _layouts++;
+}
+
+
+/* Draw every cell into the layer's own texture, returning false if it has none */
+bool UILayer::bake() {
+
+    if (!usable || renderer == nullptr || render_config.backend() != nullptr) return false;
+
+    if (!SDL_RenderTargetSupported(renderer)) {
+        usable = false;
+        return false;
+    }
+
+    const int w = std::max(1, size.first  * TILE_RENDER_WIDTH);
+    const int h = std::max(1, size.second * TILE_RENDER_HEIGHT);
+
+    if (texture == nullptr || texture_w != w || texture_h != h) {
+        if (texture) SDL_DestroyTexture(texture);
+
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        if (texture == nullptr) {
+            fprintf(stderr, "SDL_CreateTexture Error: %s\n", SDL_GetError());
+            usable = false;
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        texture_w = w;
+        texture_h = h;
+    }
+
+    // whatever was being drawn to is drawn to again afterwards
+    SDL_Texture *target = SDL_GetRenderTarget(renderer);
+
+    SDL_SetRenderTarget(renderer, texture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+
+    bool ok = true;
+    for (const UICell &cell : cells) {
+        ok = draw_tile(cell.tile, std::make_pair(cell.pos.first, cell.pos.second), style_from_palette(cell.color));
+        if (!ok) break;
+    }
+
+    SDL_SetRenderTarget(renderer, target);
+
+    generation = render_config.generation();
+    _bakes++;
+
+    return ok;
+}
+
+
+bool UILayer::draw() {
+
+    if (dirty) {
+        lay_out();
+        dirty = false;
+        baked = false;
+    }
+
+    if (generation != render_config.generation()) baked = false;
+    if (!baked) baked = bake();
+
+    if (baked) {
+        const SDL_Rect dest{ pos.first * TILE_RENDER_WIDTH, pos.second * TILE_RENDER_HEIGHT, texture_w, texture_h };
+        if (SDL_RenderCopy(renderer, texture, nullptr, &dest) < 0) {
+            fprintf(stderr, "SDL_RenderCopy Error: %s\n", SDL_GetError());
+            return false;
+        }
+        return true;
+    }
+
+    // without a texture of its own, the layer is drawn tile by tile
+    for (const UICell &cell : cells) {
+        const Pair<int8_t> at = std::make_pair(pos.first + cell.pos.first, pos.second + cell.pos.second);
+        if (!draw_tile(cell.tile, at, style_from_palette(cell.color))) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,246 @@
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "types.h"
+#include "text.h"
+
+
+class UILayer;
+
+
+/* A tile of a widget, where it sits in its layer and its color */
+struct UICell {
+    Tile          tile;
+    Pair<uint8_t> pos;
+    PaletteColor  color;
+};
+
+
+
+/*
+    A part of a retained interface, like a panel or a menu,
+    owning the widgets inside it.
+
+    Layout happens in two passes over the whole tree, and only
+    when something in it has changed: sizes are measured from
+    the leaves up, then boxes are handed out from the root down.
+    Each widget then paints its own tiles, and not those of the
+    widgets inside it. Positions are in tiles, from the top left
+    corner of the layer the tree is drawn in.
+*/
+class Widget {
+public:
+
+    Widget();
+    virtual ~Widget();
+
+    Widget(const Widget &) = delete;
+    Widget &operator=(const Widget &) = delete;
+
+    /* Make a widget inside this one, after any made before */
+    template <typename T, typename... Args>
+    T &add(Args &&... args) {
+        T *child = new T(std::forward<Args>(args)...);
+        child->parent = this;
+        children.emplace_back(child);
+        changed();
+        return *child;
+    }
+
+    Pair<uint8_t> position() const;
+    Pair<uint8_t> size()     const;
+
+protected:
+
+    /* Something shown has changed, so the whole tree needs laying out again */
+    void changed();
+
+    /* The size wanted, given the sizes already wanted by the children */
+    virtual Pair<uint8_t> measure() const = 0;
+
+    /* Hand the children their boxes, within the one given to this widget */
+    virtual void arrange();
+
+    /* Add this widget's own tiles */
+    virtual void paint(std::vector<UICell> &) const = 0;
+
+    /* The size the child wanted, when measured */
+    static Pair<uint8_t> wanted(const Widget &child);
+
+    static void place(Widget &child, Pair<uint8_t> pos, Pair<uint8_t> size);
+
+    std::vector<std::unique_ptr<Widget>> children;
+
+private:
+
+    friend class UILayer;
+
+    void measure_tree();
+    void arrange_tree(Pair<uint8_t> pos, Pair<uint8_t> size);
+    void paint_tree(std::vector<UICell> &) const;
+
+    Widget  *parent;
+    UILayer *layer; // the layer drawing the tree, kept by the root only
+
+    Pair<uint8_t> _wanted, _pos, _size;
+
+};
+
+
+
+/* A line or more of text, wrapped if it is given a width */
+class Label : public Widget {
+public:
+
+    Label(const std::string &text, PaletteColor = PaletteColor::FG_1,
+          uint8_t width = 0, TextAlign = TextAlign::LEFT);
+
+    const std::string &text() const;
+    void               text(const std::string &);
+
+protected:
+
+    Pair<uint8_t> measure() const override;
+    void          paint(std::vector<UICell> &) const override;
+
+private:
+
+    std::string  _text;
+    PaletteColor color;
+    uint8_t      width; // 0 for as wide as the longest line
+    TextAlign    align;
+
+};
+
+
+
+/* Widgets stacked from the top down, each as wide as the widest */
+class List : public Widget {
+protected:
+
+    Pair<uint8_t> measure() const override;
+    void          arrange() override;
+    void          paint(std::vector<UICell> &) const override;
+
+    /* Stack the children from `origin`, `width` tiles across */
+    void stack(Pair<uint8_t> origin, uint8_t width);
+
+};
+
+
+
+/*
+    A list inside a frame of tiles from a `BORDER_*` family
+    (any tile of the family will do), with an optional title
+    over the top edge.
+*/
+class Panel : public List {
+public:
+
+    Panel(Tile border = Tile::BORDER_NONE, PaletteColor = PaletteColor::FG_1, const std::string &title = "");
+
+protected:
+
+    Pair<uint8_t> measure() const override;
+    void          arrange() override;
+    void          paint(std::vector<UICell> &) const override;
+
+private:
+
+    Tile         border;
+    PaletteColor color;
+    std::string  title;
+
+};
+
+
+
+/* A list of choices, with `MENU_CURSOR_SELECTED` by the one selected */
+class Menu : public Widget {
+public:
+
+    Menu(const std::vector<std::string> &items, PaletteColor = PaletteColor::FG_1,
+         PaletteColor selected = PaletteColor::FG_2);
+
+    const std::vector<std::string> &items() const;
+    void                            items(const std::vector<std::string> &);
+
+    size_t selected() const;
+    void   select(size_t);
+
+    /* Move the selection by `by` items, wrapping around either end */
+    void move(int by);
+
+protected:
+
+    Pair<uint8_t> measure() const override;
+    void          paint(std::vector<UICell> &) const override;
+
+private:
+
+    std::vector<std::string> _items;
+    PaletteColor color, selected_color;
+    size_t       _selected;
+
+};
+
+
+
+/*
+    A tree of widgets drawn at `pos` on screen, laid out and
+    painted again only after something in it has changed.
+
+    With the SDL renderer, the tiles painted are drawn once into
+    a texture of their own, which is all that is drawn every
+    frame after, until the tree changes or the palette or tile
+    map of `render_config` is replaced. Other backends have the
+    tiles drawn every frame, but never laid out again for it.
+*/
+class UILayer {
+public:
+
+    UILayer(Widget *&&root, Pair<int8_t> pos);
+    ~UILayer();
+
+    UILayer(const UILayer &) = delete;
+    UILayer &operator=(const UILayer &) = delete;
+
+    Widget &root();
+
+    void move(Pair<int8_t>);
+
+    /* Lay the tree out again before it is next drawn */
+    void invalidate();
+
+    bool draw();
+
+    /* The number of times the tree was laid out, and its texture drawn */
+    uint32_t layouts() const;
+    uint32_t bakes()   const;
+
+private:
+
+    void lay_out();
+    bool bake();
+
+    std::unique_ptr<Widget> _root;
+    Pair<int8_t>            pos;
+
+    std::vector<UICell> cells;
+    Pair<uint8_t>       size;
+
+    SDL_Texture *texture;
+    int          texture_w, texture_h;
+
+    uint32_t generation; // of render_config, when last baked
+    bool     dirty, baked, usable;
+
+    uint32_t _layouts, _bakes;
+
+};
@@ -0,0 +1,150 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#include "types.h"
+#include "watch.h"
+
+
+// How often modification times are checked, without inotify
+static constexpr std::chrono::milliseconds WATCH_INTERVAL(500);
+
+
+static void split_path(const std::string &path, std::string &directory, std::string &name) {
+    const size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        directory = ".";
+        name      = path;
+    } else {
+        directory = slash ? path.substr(0, slash) : path.substr(0, 1);
+        name      = path.substr(slash + 1);
+    }
+}
+
+
+/* The modification time of `path`, or -1 if it does not exist */
+static int64_t modified_time(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return -1;
+    return (int64_t)st.st_mtime;
+}
+
+
+
+/* Implementation of FileWatcher */
+
+
+FileWatcher::FileWatcher()
+    : fd{-1}, last_checked{std::chrono::steady_clock::now()} {
+
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "FileWatcher Error: inotify is unavailable, checking files by time instead\n");
+    }
+#endif
+}
+
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+
+bool FileWatcher::watch(const std::string &file, OnChange on_change) {
+
+    Watched w;
+    w.path = file;
+    split_path(file, w.directory, w.name);
+    w.on_change = on_change;
+    w.wd        = -1;
+    w.modified  = modified_time(file);
+    w.changed   = false;
+
+#ifdef __linux__
+    if (fd >= 0) {
+        // only whole writes, so a file is never reloaded half written;
+        // watching the same directory twice gives back the same watch
+        w.wd = inotify_add_watch(fd, w.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (w.wd < 0) {
+            fprintf(stderr, "FileWatcher Error: could not watch %s\n", w.directory.c_str());
+            return false;
+        }
+    }
+#endif
+
+    files.push_back(w);
+    return true;
+}
+
+
+void FileWatcher::poll() {
+
+#ifdef __linux__
+    if (fd >= 0) {
+
+        alignas(struct inotify_event) char buffer[4096];
+
+        for (;;) {
+            const ssize_t n = read(fd, buffer, sizeof buffer);
+            if (n <= 0) break;
+
+            for (const char *p = buffer; p < buffer + n;) {
+                const struct inotify_event *ev = (const struct inotify_event *)p;
+
+                for (Watched &w : files) {
+                    // events were dropped, so anything may have changed
+                    if (ev->mask & IN_Q_OVERFLOW) w.changed = true;
+                    else if (ev->len && ev->wd == w.wd && w.name == ev->name) w.changed = true;
+                }
+
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+
+    } else
+#endif
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last_checked < WATCH_INTERVAL) return;
+        last_checked = now;
+
+        for (Watched &w : files) {
+            const int64_t m = modified_time(w.path);
+            if (m == w.modified) continue;
+
+            // a file deleted (perhaps on its way to being replaced) is left alone
+            w.modified = m;
+            if (m >= 0) w.changed = true;
+        }
+    }
+
+    // the callbacks are gathered first, since they may change what is watched
+    std::vector<OnChange> due;
+    for (Watched &w : files) {
+        if (!w.changed) continue;
+        w.changed = false;
+        due.push_back(w.on_change);
+    }
+
+    for (const OnChange &on_change : due) on_change();
+}
+
+
+void FileWatcher::clear() {
+    // the directories stay watched by inotify, which is harmless, and
+    // lets a file there be watched again without a new watch
+    files.clear();
+}
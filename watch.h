@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+
+#include "types.h"
+
+
+/*
+    Notices when files on disk change, so that assets can be
+    reloaded while the game runs.
+
+    On Linux this uses inotify, watching the directory holding
+    each file so that editors which save by writing a new file
+    and renaming it over the old one are still noticed. Elsewhere
+    the modification times of the files are checked instead,
+    a couple of times a second.
+
+    Nothing happens in the background: `poll` never blocks,
+    and it calls the callbacks itself, at most once per file
+    per call however many times the file was written.
+*/
+class FileWatcher {
+public:
+
+    typedef std::function<void()> OnChange;
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    /* Call `on_change` whenever `file` is changed. Returns false if it cannot be watched */
+    bool watch(const std::string &file, OnChange on_change);
+
+    /* Stop watching every file; callbacks may call this, and `watch` again */
+    void clear();
+
+    /* Check for changes, calling the callback of each file which changed */
+    void poll();
+
+private:
+
+    struct Watched {
+        std::string path, directory, name;
+        OnChange    on_change;
+        int         wd;       // inotify watch on the directory
+        int64_t     modified; // when inotify is unavailable
+        bool        changed;
+    };
+
+    std::vector<Watched> files;
+
+    int fd;
+
+    std::chrono::steady_clock::time_point last_checked;
+
+};
@@ -0,0 +1,97 @@
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "types.h"
+#include "grid.h"
+#include "world.h"
+
+
+
+/* Implementation of World */
+
+World::World(uint16_t chunks_wide, uint16_t chunks_high, Tile fill)
+    : World(chunks_wide, chunks_high, nullptr, fill) { }
+
+World::World(uint16_t chunks_wide, uint16_t chunks_high, ChunkSource *source, Tile fill)
+    : _chunks_wide{chunks_wide}
+    , _chunks_high{chunks_high}
+    , fill{fill}
+    , source{source}
+    , chunks((size_t)chunks_wide * chunks_high)
+    { }
+
+
+uint16_t World::chunks_wide() const { return _chunks_wide; }
+uint16_t World::chunks_high() const { return _chunks_high; }
+
+uint32_t World::width()  const { return (uint32_t)_chunks_wide * CHUNK_SIZE; }
+uint32_t World::height() const { return (uint32_t)_chunks_high * CHUNK_SIZE; }
+
+
+bool World::in_bounds(int32_t x, int32_t y) const {
+    return x >= 0 && y >= 0 && (uint32_t)x < width() && (uint32_t)y < height();
+}
+
+
+bool World::loaded(uint16_t cx, uint16_t cy) const {
+    return chunks[(size_t)cy * _chunks_wide + cx] != nullptr;
+}
+
+
+Chunk &World::chunk(uint16_t cx, uint16_t cy) {
+
+    std::unique_ptr<Chunk> &slot = chunks[(size_t)cy * _chunks_wide + cx];
+
+    if (slot == nullptr) {
+        slot = std::unique_ptr<Chunk>(new Chunk);
+
+        // fall back to an empty chunk if there is nothing
+        // to load from, or the source could not provide it
+        if (source == nullptr || !source->load(cx, cy, *slot)) {
+            std::fill(slot->tiles, slot->tiles + CHUNK_TILES, fill);
+        }
+    }
+
+    return *slot;
+}
+
+
+const Chunk &World::peek(uint16_t cx, uint16_t cy, Chunk &scratch) const {
+
+    const std::unique_ptr<Chunk> &slot = chunks[(size_t)cy * _chunks_wide + cx];
+
+    if (slot != nullptr)
+        return *slot;
+
+    if (source == nullptr || !source->load(cx, cy, scratch)) {
+        std::fill(scratch.tiles, scratch.tiles + CHUNK_TILES, fill);
+    }
+
+    return scratch;
+}
+
+
+Tile World::at(int32_t x, int32_t y) {
+    return chunk(x / CHUNK_SIZE, y / CHUNK_SIZE).at(x % CHUNK_SIZE, y % CHUNK_SIZE);
+}
+
+void World::set(int32_t x, int32_t y, Tile t) {
+    chunk(x / CHUNK_SIZE, y / CHUNK_SIZE).at(x % CHUNK_SIZE, y % CHUNK_SIZE) = t;
+}
+
+
+void World::read(TileGrid &grid, int32_t x, int32_t y) {
+    for (uint16_t j = 0; j < grid.height(); j++)
+    for (uint16_t i = 0; i < grid.width();  i++) {
+        grid.at(i, j) = in_bounds(x + i, y + j) ? at(x + i, y + j) : fill;
+    }
+}
+
+void World::write(const TileGrid &grid, int32_t x, int32_t y) {
+    for (uint16_t j = 0; j < grid.height(); j++)
+    for (uint16_t i = 0; i < grid.width();  i++) {
+        if (in_bounds(x + i, y + j))
+            set(x + i, y + j, grid.at(i, j));
+    }
+}
@@ -0,0 +1,100 @@
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "types.h"
+#include "grid.h"
+
+
+
+// The number of tiles across (and high) a single chunk.
+static constexpr uint16_t CHUNK_SIZE = 32u;
+
+// The number of tiles within a single chunk.
+static constexpr uint16_t CHUNK_TILES = CHUNK_SIZE * CHUNK_SIZE;
+
+
+
+/*
+    A square, fixed-size block of the world map.
+    Tiles are stored row-major so that a chunk
+    can be copied, encoded or decoded as one flat array.
+*/
+struct Chunk {
+
+    Tile tiles[CHUNK_TILES];
+
+    Tile &at(uint16_t x, uint16_t y)       { return tiles[y * CHUNK_SIZE + x]; }
+    Tile  at(uint16_t x, uint16_t y) const { return tiles[y * CHUNK_SIZE + x]; }
+
+};
+
+
+/*
+    Anything which is able to provide the contents
+    of a chunk on demand, such as a saved world file.
+*/
+class ChunkSource {
+public:
+
+    virtual ~ChunkSource() { }
+
+    /* Fill `out` with the chunk at chunk coordinates (cx, cy) */
+    virtual bool load(uint16_t cx, uint16_t cy, Chunk &out) = 0;
+
+};
+
+
+/*
+    A map made up of chunks, which are only
+    materialized (from the source, if there is one)
+    the first time they are touched.
+*/
+class World {
+public:
+
+    World(uint16_t chunks_wide, uint16_t chunks_high, Tile fill = Tile::PUNCT_SPACE);
+
+    World(uint16_t chunks_wide, uint16_t chunks_high, ChunkSource *, Tile fill = Tile::PUNCT_SPACE);
+
+    uint16_t chunks_wide() const;
+    uint16_t chunks_high() const;
+
+    uint32_t width()  const;
+    uint32_t height() const;
+
+    bool in_bounds(int32_t x, int32_t y) const;
+
+    Tile at(int32_t x, int32_t y);
+    void set(int32_t x, int32_t y, Tile);
+
+    /* Whether the chunk has been materialized yet */
+    bool loaded(uint16_t cx, uint16_t cy) const;
+
+    /* The chunk at chunk coordinates (cx, cy), loading it if needed */
+    Chunk &chunk(uint16_t cx, uint16_t cy);
+
+    /*
+        The chunk at chunk coordinates (cx, cy) if it is loaded,
+        otherwise its contents are produced in `scratch` without
+        keeping them around (useful for saving large worlds).
+    */
+    const Chunk &peek(uint16_t cx, uint16_t cy, Chunk &scratch) const;
+
+    /* Copy a region of the world into a grid, or a grid into the world */
+    void read(TileGrid &, int32_t x, int32_t y);
+    void write(const TileGrid &, int32_t x, int32_t y);
+
+private:
+
+    uint16_t _chunks_wide, _chunks_high;
+
+    Tile fill;
+
+    ChunkSource *source;
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+
+};